@@ -60,6 +60,9 @@ ISR_NOERR 29
 ISR_NOERR 30
 ISR_NOERR 31
 
+; yield, goes through isr_handler so the pic gets no eoi
+ISR_NOERR 126
+
 extern isr_handler
 
 isr_common_stub:
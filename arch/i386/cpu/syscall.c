@@ -7,6 +7,8 @@
 #include <video/vbe.h>
 #include <fs/vfs.h>
 #include <mm/kheap.h>
+#include <mm/mmap.h>
+#include <mm/shm.h>
 #include <gui/compositor.h>
 
 #include <assert.h>
@@ -16,7 +18,9 @@
 
 extern void __task_exit(int);
 extern void *malloc_int(uint32_t);
-extern void free_int(void*);
+extern int free_int(void*);
+extern void *region_int(uint32_t);
+extern void *resize_region_int(void *, uint32_t);
 
 extern _Bool addresses[MAX_PROCESS];
 
@@ -34,7 +38,20 @@ syscall_t syscall_table[] = {
     sys_get_state,
     sys_get_display_info,
     sys_request_buffer,
-    sys_buffer_ready
+    sys_buffer_ready,
+    sys_region,
+    sys_free_region,
+    sys_shm_create,
+    sys_shm_map,
+    sys_shm_unmap,
+    sys_shm_destroy,
+    sys_mmap,
+    sys_munmap,
+    sys_resize_region,
+    sys_mem_stats,
+    sys_set_nice,
+    sys_set_rt,
+    sys_rt_wait
 };
 
 uint32_t NUM_SYSCALLS = sizeof(syscall_table) / sizeof(syscall_t);
@@ -44,6 +61,11 @@ static _Bool is_user_address(const void *ptr) {
     uint32_t addr = (uint32_t) ptr - BIN_BASE_ADDR;
     uint32_t user_region_size = BIN_END_ADDR - BIN_BASE_ADDR;
 
+    // shared memory mapped by the calling task
+    if (shm_is_mapped((uint32_t) ptr, crt_dir)) {
+        return 1;
+    }
+
     // address not in user region or not allocated
     if (addr > user_region_size || addresses[addr / MAX_PROCESS_SIZE] == 0) {
         return 0;
@@ -80,10 +102,12 @@ uint32_t sys_exit(uint32_t ret, uint32_t unused1, uint32_t unused2, uint32_t unu
 uint32_t sys_write(uint32_t fd, uint32_t size, uint32_t buf, uint32_t unused1, uint32_t unused2) {
     file_t *dev = dev_by_idx(fd);
     if (dev != NULL) {
+        uint32_t ret = EPERM;
         if ((dev->mode & MODE_W) != 0) {
-            return dev->device->write(dev, size, (uint8_t *) buf);
+            ret = dev->device->write(dev, size, (uint8_t *) buf);
         }
-        return EPERM;
+        kmem_cache_free(file_cache, dev);
+        return ret;
     } else {
         // if fd is not a device, it must be a file_t pointer
         file_t *file = (file_t *) fd;
@@ -96,13 +120,17 @@ uint32_t sys_write(uint32_t fd, uint32_t size, uint32_t buf, uint32_t unused1, u
     __builtin_unreachable();
 }
 
-uint32_t sys_read(uint32_t fd, uint32_t size, uint32_t buf, uint32_t unused1, uint32_t unused2) {
+// the device handle only lives for this call, offset is where generated devices (/dev/kheap) start reading
+uint32_t sys_read(uint32_t fd, uint32_t size, uint32_t buf, uint32_t offset, uint32_t unused1) {
     file_t *dev = dev_by_idx(fd);
     if (dev != NULL) {
+        uint32_t ret = EPERM;
         if ((dev->mode & MODE_R) != 0) {
-            return dev->device->read(dev, size, (uint8_t *) buf);
+            dev->ptr_local = offset;
+            ret = dev->device->read(dev, size, (uint8_t *) buf);
         }
-        return EPERM;
+        kmem_cache_free(file_cache, dev);
+        return ret;
     }
 
     return ENODEV;
@@ -127,13 +155,175 @@ uint32_t sys_malloc(uint32_t size, uint32_t unused1, uint32_t unused2, uint32_t
 }
 
 uint32_t sys_free(uint32_t addr, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4) {
-    if (addr) {
-        free_int((void *) addr);
+    if (addr && free_int((void *) addr) == 0) {
         return 0;
     }
     return (uint32_t) -1;
 }
 
+// large chunks for the user space allocator, which splits them up without trapping into the kernel
+uint32_t sys_region(uint32_t size, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4) {
+    void *ptr = region_int(size);
+
+    if (ptr == NULL) return (uint32_t) -1;
+
+    return (uint32_t) ptr;
+}
+
+uint32_t sys_free_region(uint32_t addr, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4) {
+    if (addr == 0 || addr % PAGE_SIZE != 0) {
+        return EINVAL;
+    }
+
+    return free_int((void *) addr);
+}
+
+// the region keeps its contents, it is moved only when it can't grow in place
+uint32_t sys_resize_region(uint32_t addr, uint32_t size, uint32_t unused1, uint32_t unused2, uint32_t unused3) {
+    if (addr == 0 || addr % PAGE_SIZE != 0) {
+        return (uint32_t) -1;
+    }
+
+    void *ptr = resize_region_int((void *) addr, size);
+    if (ptr == NULL) return (uint32_t) -1;
+
+    return (uint32_t) ptr;
+}
+
+// fills a task_mem_t for the task pid, or for the calling task when pid = -1
+uint32_t sys_mem_stats(uint32_t pid, uint32_t user_buffer, uint32_t unused1, uint32_t unused2, uint32_t unused3) {
+    if (pid == (uint32_t) -1) {
+        pid = getpid();
+    }
+
+    tcb_t *t = get_task(pid);
+    if (t == NULL || t->state == TASK_TERMINATED) {
+        return (uint32_t) -1;
+    }
+
+    task_mem_t st;
+    task_mem_usage(t, &st);
+
+    if (copy_to_user((void *) user_buffer, &st, sizeof(task_mem_t))) {
+        return (uint32_t) -1;
+    }
+
+    return 0;
+}
+
+// a task may only change the scheduling or the address space of itself and of the tasks it created
+static uint32_t may_control(uint32_t pid) {
+    tcb_t *t = get_task(pid);
+
+    if (t == NULL || t->state == TASK_TERMINATED) {
+        return ESRCH;
+    }
+    if ((int) pid != getpid() && t->parent != getpid()) {
+        return EPERM;
+    }
+
+    return 0;
+}
+
+uint32_t sys_set_nice(uint32_t pid, uint32_t nice, uint32_t unused1, uint32_t unused2, uint32_t unused3) {
+    if (pid == (uint32_t) -1) {
+        pid = getpid();
+    }
+
+    uint32_t err = may_control(pid);
+    if (err) {
+        return err;
+    }
+
+    return (uint32_t) task_set_nice(pid, nice);
+}
+
+// EBUSY when admission control turns the task down
+uint32_t sys_set_rt(uint32_t pid, uint32_t period, uint32_t budget, uint32_t deadline, uint32_t unused1) {
+    if (pid == (uint32_t) -1) {
+        pid = getpid();
+    }
+
+    uint32_t err = may_control(pid);
+    if (err) {
+        return err;
+    }
+
+    return (uint32_t) task_set_rt(pid, period, budget, deadline);
+}
+
+uint32_t sys_rt_wait(uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4, uint32_t unused5) {
+    task_rt_wait();
+    return 0;
+}
+
+// returns the address of the new segment, which is also its key for the other shm calls
+uint32_t sys_shm_create(uint32_t size, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4) {
+    if (getpid() == -1) return (uint32_t) -1;
+
+    uint32_t addr = shm_create(size, crt_dir);
+    if (addr == 0) return (uint32_t) -1;
+
+    return addr;
+}
+
+// maps a segment into the task pid, or into the calling task when pid = -1
+uint32_t sys_shm_map(uint32_t addr, uint32_t pid, uint32_t unused1, uint32_t unused2, uint32_t unused3) {
+    pagedir_t *dir = crt_dir;
+
+    if (pid != (uint32_t) -1) {
+        uint32_t err = may_control(pid);
+        if (err) {
+            return err;
+        }
+        dir = get_task(pid)->page_dir;
+    }
+
+    addr = shm_map(addr, dir);
+    if (addr == 0) return (uint32_t) -1;
+
+    return addr;
+}
+
+uint32_t sys_shm_unmap(uint32_t addr, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4) {
+    return shm_unmap(addr, crt_dir);
+}
+
+// only the task that created a segment may destroy it
+uint32_t sys_shm_destroy(uint32_t addr, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4) {
+    int owner = shm_owner(addr);
+    if (owner == -1) {
+        return EINVAL;
+    }
+    if (owner != getpid()) {
+        return EPERM;
+    }
+
+    return shm_destroy(addr);
+}
+
+// maps size bytes of a file starting at offset (page aligned), pages are read from the page cache on first access
+uint32_t sys_mmap(uint32_t user_path, uint32_t offset, uint32_t size, uint32_t unused1, uint32_t unused2) {
+    char kernel_path[256] = {0};
+
+    if (getpid() == -1) return (uint32_t) -1;
+
+    if (copy_from_user(kernel_path, (void *) user_path, sizeof(kernel_path) - 1)) {
+        return (uint32_t) -1;
+    }
+
+    uint32_t addr = mmap_file(get_task(getpid()), kernel_path, offset, size);
+    if (addr == 0) return (uint32_t) -1;
+
+    return addr;
+}
+
+uint32_t sys_munmap(uint32_t addr, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4) {
+    if (getpid() == -1) return EPERM;
+
+    return munmap_file(get_task(getpid()), addr);
+}
+
 /* 
     this function will copy kernel heap data to user buffers so the data can be freed from a user task.
 
@@ -169,7 +359,7 @@ uint32_t sys_listdir(uint32_t user_path, uint32_t user_buffer, uint32_t buffer_s
 
     if (buffer_size < needed_size) {
         for (uint32_t i = 0; i < count; i++) {
-            kfree(nodes[i]);
+            kmem_cache_free(node_cache, nodes[i]);
         }
         kfree(nodes);
         return ENOMEM;
@@ -178,7 +368,7 @@ uint32_t sys_listdir(uint32_t user_path, uint32_t user_buffer, uint32_t buffer_s
     node_t *nodes_buffer = (node_t *) kmalloc(needed_size);
     if (!nodes_buffer) {
         for (uint32_t i = 0; i < count; i++) {
-            kfree(nodes[i]);
+            kmem_cache_free(node_cache, nodes[i]);
         }
         kfree(nodes);
 
@@ -192,7 +382,7 @@ uint32_t sys_listdir(uint32_t user_path, uint32_t user_buffer, uint32_t buffer_s
     // copy nodes to user space
     if (copy_to_user((void *) user_buffer, nodes_buffer, needed_size)) {
         for (uint32_t i = 0; i < count; i++) {
-            kfree(nodes[i]);
+            kmem_cache_free(node_cache, nodes[i]);
         }
         kfree(nodes);
         kfree(nodes_buffer);
@@ -200,7 +390,7 @@ uint32_t sys_listdir(uint32_t user_path, uint32_t user_buffer, uint32_t buffer_s
     }
 
     for (uint32_t i = 0; i < count; i++) {
-        kfree(nodes[i]);
+        kmem_cache_free(node_cache, nodes[i]);
     }
     kfree(nodes);
     kfree(nodes_buffer);
@@ -326,7 +516,7 @@ uint32_t sys_request_buffer(uint32_t width, uint32_t height, uint32_t unused1, u
     }
     tasks[crt_task].heap = mkheap(
         heap_start,
-        heap_start + KHEAP_INITIAL_SZ,
+        heap_start + USER_HEAP_INITIAL_SZ,
         buffer_start - 1,
         0, 0
     );
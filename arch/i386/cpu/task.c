@@ -1,10 +1,16 @@
 #include <bin.h>
+#include <errno.h>
 #include <string.h>
 
 #include <asm/io.h>
+#include <fs/vfs.h>
 #include <int/gdt.h>
 #include <int/task.h>
+#include <mm/buddy.h>
+#include <mm/mmap.h>
 #include <mm/paging.h>
+#include <mm/shm.h>
+#include <mm/zpool.h>
 
 uint8_t is_tasking_enabled = 0;
 
@@ -12,6 +18,32 @@ tcb_t tasks[MAX_TASKS];
 volatile int crt_task = -1;
 int ntasks = 0;
 
+/*
+    ready tasks wait in one fifo per priority, bit i of runq_map is set when runq[i] is not empty.
+    the running task and the idle task are never queued. sleeping tasks are only on the timer wheel
+
+    the levels form a multi level feedback queue: a task that uses up its quantum is cpu bound and
+    drops a level, where the quantum is longer. waking up lifts a task one level and the boost
+    timer periodically puts everyone back on their top level, which is set by the nice value.
+
+    real time tasks are kept apart, sorted by absolute deadline, and always go before the levels.
+    each one gets at most its budget per period, then it is throttled until the next release
+*/
+static struct {
+    tcb_t *head;
+    tcb_t *tail;
+} runq[SCHED_NPRIO];
+static uint32_t runq_map = 0;
+
+static const uint8_t quantum[SCHED_NPRIO] = {1, 2, 2, 4, 4, 8, 8, 16}; // ticks
+
+static ktimer_t boost_timer;
+
+static tcb_t *edf_head = NULL;
+static uint32_t rt_util = 0; // permille reserved by the admitted real time tasks
+
+static void yield_handler(regs_t *regs);
+
 void check_stack_usage(tcb_t *task) {
     if (task->regs.esp < (uint32_t)task->kernel_stack ||
         task->regs.esp >= (uint32_t)&task->kernel_stack[KERNEL_STACK_SIZE]) {
@@ -25,34 +57,391 @@ int getpid() {
 }
 
 tcb_t *get_task(int pid) {
-    if (pid < 0 || pid >= ntasks) {
+    if (pid < 0 || pid >= ntasks || tasks[pid].state == TASK_UNUSED) {
         return NULL;
     }
 
     return &tasks[pid];
 }
 
+static void runq_push(tcb_t *task) {
+    uint8_t p = task->prio;
+
+    task->next = NULL;
+    task->prev = runq[p].tail;
+    if (runq[p].tail) {
+        runq[p].tail->next = task;
+    } else {
+        runq[p].head = task;
+    }
+    runq[p].tail = task;
+
+    runq_map |= 1 << p;
+}
+
+static void runq_remove(tcb_t *task) {
+    uint8_t p = task->prio;
+
+    if (task->prev) {
+        task->prev->next = task->next;
+    } else {
+        runq[p].head = task->next;
+    }
+    if (task->next) {
+        task->next->prev = task->prev;
+    } else {
+        runq[p].tail = task->prev;
+    }
+    task->next = task->prev = NULL;
+
+    if (runq[p].head == NULL) {
+        runq_map &= ~(1 << p);
+    }
+}
+
+static int deadline_before(tcb_t *a, tcb_t *b) {
+    return (int32_t) (a->rt.abs_deadline - b->rt.abs_deadline) < 0;
+}
+
+// equal deadlines keep fifo order
+static void edf_insert(tcb_t *task) {
+    tcb_t *prev = NULL;
+    tcb_t *cur = edf_head;
+
+    while (cur && !deadline_before(task, cur)) {
+        prev = cur;
+        cur = cur->next;
+    }
+
+    task->prev = prev;
+    task->next = cur;
+    if (prev) {
+        prev->next = task;
+    } else {
+        edf_head = task;
+    }
+    if (cur) {
+        cur->prev = task;
+    }
+}
+
+static void edf_remove(tcb_t *task) {
+    if (task->prev) {
+        task->prev->next = task->next;
+    } else {
+        edf_head = task->next;
+    }
+    if (task->next) {
+        task->next->prev = task->prev;
+    }
+    task->next = task->prev = NULL;
+}
+
+static void make_ready(tcb_t *task) {
+    task->state = TASK_READY;
+
+    if (task->rt.period) {
+        edf_insert(task);
+    } else {
+        runq_push(task);
+    }
+}
+
+// takes a ready task off whichever queue it is on
+static void dequeue(tcb_t *task) {
+    if (task->rt.period) {
+        edf_remove(task);
+    } else {
+        runq_remove(task);
+    }
+}
+
+static uint32_t rt_share(tcb_t *task) {
+    return (task->rt.period) ? task->rt.budget * 1000 / task->rt.deadline : 0;
+}
+
+// moves a task to another level with a fresh quantum, interrupts have to be off
+static void set_level(tcb_t *task, uint8_t prio) {
+    if (task->state == TASK_READY) {
+        runq_remove(task);
+        task->prio = prio;
+        runq_push(task);
+    } else {
+        task->prio = prio;
+    }
+
+    task->slice = quantum[prio];
+}
+
+// a blocked task that waited for something goes one level up, throttled ones only wake on release
+static void wake(tcb_t *task) {
+    if (task->state != TASK_BLOCKED || task->rt.throttled) {
+        return;
+    }
+
+    if (task->rt.period == 0) {
+        set_level(task, (task->prio > task->nice) ? task->prio - 1 : task->nice);
+    }
+    make_ready(task);
+}
+
+// release timer callback: a new period starts with a fresh budget and deadline
+static void rt_release(void *arg) {
+    tcb_t *task = (tcb_t *) arg;
+
+    if (task->rt.period == 0 || task->state == TASK_TERMINATED || task->state == TASK_UNUSED) {
+        return;
+    }
+
+    int queued = task->state == TASK_READY;
+    if (queued) {
+        edf_remove(task);
+    }
+
+    task->rt.release += task->rt.period;
+    task->rt.abs_deadline = task->rt.release + task->rt.deadline;
+    task->rt.used = 0;
+
+    if (queued || task->rt.throttled) {
+        task->rt.throttled = 0;
+        make_ready(task);
+    }
+
+    timer_arm(&task->rt.timer, task->rt.release + task->rt.period);
+}
+
+// sleep timer callback, runs from the tick handler
+static void wake_task(void *arg) {
+    wake((tcb_t *) arg);
+}
+
+// aging, demoted tasks can't starve behind a stream of interactive ones
+static void boost_tasks(void *unused) {
+    for (int i = 1; i < ntasks; i++) {
+        tcb_t *task = &tasks[i];
+
+        if (task->state != TASK_UNUSED && task->state != TASK_TERMINATED &&
+            task->rt.period == 0 && task->prio != task->nice) {
+            set_level(task, task->nice);
+        }
+    }
+
+    timer_arm(&boost_timer, pit_get_ticks() + SCHED_BOOST_TICKS);
+}
+
+// blocks the running task, interrupts have to be off until it yields
+void task_sleep(uint32_t ticks) {
+    tcb_t *task = &tasks[crt_task];
+
+    task->state = TASK_BLOCKED;
+    timer_arm(&task->sleep_timer, pit_get_ticks() + ((ticks) ? ticks : 1));
+}
+
+// blocks the running task until task_wake(), interrupts have to be off until it yields
+void task_block() {
+    tasks[crt_task].state = TASK_BLOCKED;
+}
+
+void task_wake(int pid) {
+    tcb_t *task = get_task(pid);
+    if (task == NULL) {
+        return;
+    }
+
+    uint32_t eflags;
+    asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+
+    wake(task);
+
+    asm volatile("push %0; popf" :: "r"(eflags) : "memory", "cc");
+}
+
+// nice n keeps the task at level n and below. a task above its new top level is moved down right away
+int task_set_nice(int pid, int nice) {
+    tcb_t *task = get_task(pid);
+    if (pid == 0 || task == NULL || task->state == TASK_TERMINATED) {
+        return ESRCH;
+    }
+    if (nice < 0 || nice > SCHED_NICE_MAX) {
+        return EINVAL;
+    }
+
+    uint32_t eflags;
+    asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+
+    task->nice = nice;
+    if (task->prio < nice && task->rt.period == 0) {
+        set_level(task, nice);
+    }
+
+    asm volatile("push %0; popf" :: "r"(eflags) : "memory", "cc");
+    return 0;
+}
+
+/*
+    moves a task into the earliest deadline first class, period 0 moves it back to the mlfq.
+    deadline 0 means the end of the period. a task is only admitted while the summed
+    budget / deadline of all real time tasks stays under SCHED_RT_MAX_UTIL, then every one of
+    them meets its deadlines
+*/
+int task_set_rt(int pid, uint32_t period, uint32_t budget, uint32_t deadline) {
+    tcb_t *task = get_task(pid);
+    if (pid == 0 || task == NULL || task->state == TASK_TERMINATED) {
+        return ESRCH;
+    }
+
+    if (deadline == 0) {
+        deadline = period;
+    }
+    if (period && (period > SCHED_RT_MAX_PERIOD || budget == 0 || budget > deadline || deadline > period)) {
+        return EINVAL;
+    }
+
+    uint32_t share = (period) ? budget * 1000 / deadline : 0;
+
+    uint32_t eflags;
+    asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+
+    if (rt_util - rt_share(task) + share > SCHED_RT_MAX_UTIL) {
+        asm volatile("push %0; popf" :: "r"(eflags) : "memory", "cc");
+        return EBUSY;
+    }
+    rt_util = rt_util - rt_share(task) + share;
+
+    int ready = task->state == TASK_READY;
+    if (ready) {
+        dequeue(task);
+    }
+    timer_cancel(&task->rt.timer);
+
+    int throttled = task->rt.throttled;
+    task->rt.period = period;
+    task->rt.budget = budget;
+    task->rt.deadline = deadline;
+    task->rt.release = pit_get_ticks();
+    task->rt.abs_deadline = task->rt.release + deadline;
+    task->rt.used = 0;
+    task->rt.throttled = 0;
+
+    if (period) {
+        timer_arm(&task->rt.timer, task->rt.release + period);
+    } else {
+        task->prio = task->nice;
+        task->slice = quantum[task->nice];
+    }
+
+    if (ready || throttled) {
+        make_ready(task);
+    }
+
+    asm volatile("push %0; popf" :: "r"(eflags) : "memory", "cc");
+    return 0;
+}
+
+// the running real time task is done with this period and waits for the next release
+void task_rt_wait() {
+    tcb_t *task = &tasks[crt_task];
+    if (task->rt.period == 0) {
+        return;
+    }
+
+    uint32_t eflags;
+    asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+
+    task->rt.throttled = 1;
+    task->state = TASK_BLOCKED;
+    task_yield();
+
+    asm volatile("push %0; popf" :: "r"(eflags) : "memory", "cc");
+}
+
+// a free slot in tasks[]. slots are reused instead of compacted, queue links and pids point into the array
+static tcb_t *alloc_tcb() {
+    int i;
+    for (i = 1; i < ntasks && tasks[i].state != TASK_UNUSED; i++);
+
+    if (i >= MAX_TASKS) {
+        return NULL;
+    }
+
+    tcb_t *task = &tasks[i];
+    memset(task, 0, __builtin_offsetof(tcb_t, kernel_stack)); // the stack is left alone
+    task->pid = i;
+    task->parent = crt_task;
+    task->state = TASK_BLOCKED; // not runnable until the caller is done
+    task->prio = 0; // new tasks start on top, nice is 0
+    task->slice = quantum[0];
+    timer_init(&task->sleep_timer, wake_task, task);
+    timer_init(&task->rt.timer, rt_release, task);
+
+    if (i == ntasks) {
+        ntasks++;
+    }
+
+    return task;
+}
+
 void cleanup_terminated_tasks() {
-    for (int i = 0; i < ntasks;) {
+    for (int i = 0; i < ntasks; i++) {
         if (tasks[i].state == TASK_TERMINATED) {
             serial_printf("Cleaning task %d (ret=%d)\n", tasks[i].pid, tasks[i].ret);
 
-            // shift remaining tasks down
-            for (int j = i; j < ntasks - 1; j++) {
-                tasks[j] = tasks[j + 1];
+            // give the address space back, the process slot itself is freed by destroy_process()
+            shm_release(tasks[i].pid, tasks[i].page_dir);
+            mmap_release(&tasks[i]);
+            free_dir(tasks[i].page_dir);
+
+            // its reservation goes back, the release timer stopped re-arming at termination
+            if (tasks[i].rt.period) {
+                asm volatile("cli");
+                timer_cancel(&tasks[i].rt.timer);
+                rt_util -= rt_share(&tasks[i]);
+                tasks[i].rt.period = 0;
+                asm volatile("sti");
             }
-            ntasks--;
-        } else {
-            i++;
+
+            if (tasks[i].heap) {
+                kfree(tasks[i].heap);
+            }
+
+            asm volatile("cli");
+            tasks[i].state = TASK_UNUSED;
+            asm volatile("sti");
         }
     }
+
+    // alloc_tcb() must not claim a trailing slot between the test and the decrement
+    uint32_t eflags;
+    asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+
+    while (ntasks > 1 && tasks[ntasks - 1].state == TASK_UNUSED) {
+        ntasks--;
+    }
+
+    asm volatile("push %0; popf" :: "r"(eflags) : "memory", "cc");
 }
 
 void idle_task() {
     serial_printf("idle_task(): Idle task started\n");
     while (1) {
+        // the heap and slab have no locks, a task woken by a tick must not run in the middle of a free
+        preempt_disable();
         cleanup_terminated_tasks();
+        preempt_enable();
+
+        zpool_refill(); // nothing else to run, prepare zeroed frames for page faults
+
+        preempt_disable();
+        dir_pool_refill();
+        preempt_enable();
+
+        // nothing is runnable, the pit stays quiet until the next timer instead of firing every tick
+        asm volatile("cli");
+        if (runq_empty()) {
+            pit_idle_enter();
+        }
         asm volatile("sti; hlt");
+        pit_idle_exit();
     }
 }
 
@@ -61,7 +450,8 @@ void init_tasking() {
     idle->pid = 0;
 
     idle->state = TASK_RUNNING;
-    idle->sleep_expiry = 0;
+    idle->prio = SCHED_NPRIO; // below every queue, only runs when they are all empty
+    idle->next = idle->prev = NULL;
     idle->ret = 0;
     idle->user = 0;
 
@@ -76,18 +466,28 @@ void init_tasking() {
     idle->regs.eip = (uint32_t) idle_task;
 
     idle->heap = NULL; // idle doesnt need a heap
+    idle->maps = NULL;
+    idle->faults = idle->major_faults = 0;
     idle->page_dir = clone_dir(kernel_dir);
-    map_memory(
+    if (idle->page_dir == NULL || map_memory(
         (uint32_t)idle->kernel_stack,
         (uint32_t)idle->kernel_stack,
         KERNEL_STACK_SIZE,
         idle->page_dir,
         1, 0
-    );
+    ) != 0) {
+        serial_printf("Out of memory while setting up the idle task\n");
+        while (1) asm("hlt");
+    }
 
     ntasks = 1;
     crt_task = -1;
 
+    register_interrupt_handler(YIELD_VECTOR, yield_handler);
+
+    timer_init(&boost_timer, boost_tasks, NULL);
+    timer_arm(&boost_timer, pit_get_ticks() + SCHED_BOOST_TICKS);
+
     is_tasking_enabled = 1;
 
     switch_page_dir(kernel_dir);
@@ -101,21 +501,28 @@ void __task_exit(int ret) {
     tasks[crt_task].state = TASK_TERMINATED;
     tasks[crt_task].ret = ret;
     serial_printf("Task %d exited with code %d\n", crt_task, ret);
-    asm volatile("int $0x20");
+    task_yield();
 
     for (;;) asm("hlt");
 }
 
 
 int create_user_task(struct process_address_space *addr) {
-    tcb_t *task = &tasks[ntasks];
+    tcb_t *task = alloc_tcb();
+    if (task == NULL) {
+        return -1;
+    }
+
     task->user = 1;
-    task->pid = ntasks;
-    task->state = TASK_READY;
-    task->sleep_expiry = 0;
-    task->ret = 0;
 
-    task->page_dir = clone_dir(kernel_dir);
+    task->page_dir = alloc_dir();
+    if (task->page_dir == NULL) {
+        task->state = TASK_UNUSED;
+        return -1;
+    }
+    task->maps = NULL;
+    task->heap = NULL;
+    task->faults = task->major_faults = 0;
 
     uint32_t entry = BIN_BASE_ADDR + addr->address_idx * MAX_PROCESS_SIZE; 
     uint32_t end_code = entry + addr->binary_size;
@@ -161,7 +568,7 @@ int create_user_task(struct process_address_space *addr) {
 
         task->heap = mkheap(
             heap_start,
-            heap_start + KHEAP_INITIAL_SZ,
+            heap_start + USER_HEAP_INITIAL_SZ,
             guard_page - 1,
             0, 0 // user, r/w
         );
@@ -170,21 +577,17 @@ int create_user_task(struct process_address_space *addr) {
     serial_printf("create_task(): User task %d created: eip=0x%x esp=0x%x\n",
               task->pid, task->regs.eip, task->regs.esp);
 
-    ntasks++;
+    make_ready(task);
     return task->pid;
 }
 
 int create_task(uint32_t eip) {
-    if (ntasks >= MAX_TASKS) {
+    tcb_t *task = alloc_tcb();
+    if (task == NULL) {
         return -1;
     }
 
-    tcb_t *task = &tasks[ntasks];
     task->user = 0;
-    task->pid = ntasks;
-    task->state = TASK_READY;
-    task->sleep_expiry = 0;
-    task->ret = 0;
 
     memset(&task->regs, 0, sizeof(regs_t));
     task->regs.cs = 0x08; // kernel cs
@@ -199,31 +602,43 @@ int create_task(uint32_t eip) {
 
     task->regs.ebp = task->regs.esp;
 
-    task->page_dir = clone_dir(kernel_dir);
+    task->page_dir = alloc_dir();
+    if (task->page_dir == NULL) {
+        task->state = TASK_UNUSED;
+        return -1;
+    }
+    task->maps = NULL;
+    task->heap = NULL;
+    task->faults = task->major_faults = 0;
 
     serial_printf("create_task(): Task %d created: eip=0x%x esp=0x%x\n",
               task->pid, task->regs.eip, task->regs.esp);
 
-    ntasks++;
+    make_ready(task);
     return task->pid;
 }
 
+int runq_empty() {
+    return runq_map == 0 && edf_head == NULL;
+}
+
+// takes the real time task with the earliest deadline, else the first task of the highest non empty queue
 int scheduler_pick_next() {
-    if (ntasks == 0) return -1;
+    if (edf_head) {
+        tcb_t *task = edf_head;
+        edf_remove(task);
 
-    int start = (crt_task + 1) % ntasks;
-    for (int i = 0; i < ntasks; i++) {
-        int idx = (start + i) % ntasks;
-        if (tasks[idx].state == TASK_READY) {
-            return idx;
-        }
+        return task->pid;
     }
 
-    if (crt_task != -1 && tasks[crt_task].state == TASK_RUNNING) {
-        return crt_task;
+    if (runq_map == 0) {
+        return -1;
     }
 
-    return -1;
+    tcb_t *task = runq[__builtin_ctz(runq_map)].head;
+    runq_remove(task);
+
+    return task->pid;
 }
 
 void kill_task(int pid, int reason) {
@@ -234,6 +649,17 @@ void kill_task(int pid, int reason) {
 
     tcb_t *task = &tasks[pid];
     if (task->state != TASK_TERMINATED) {
+        uint32_t eflags;
+        asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+
+        if (task->state == TASK_READY) {
+            dequeue(task);
+        } else if (task->state == TASK_BLOCKED) {
+            timer_cancel(&task->sleep_timer);
+        }
+
+        asm volatile("push %0; popf" :: "r"(eflags) : "memory", "cc");
+
         task->state = TASK_TERMINATED;
         task->ret = reason;
         serial_printf("kill_task(): Task %d terminated, reason = %d\n", pid, reason);
@@ -241,7 +667,7 @@ void kill_task(int pid, int reason) {
         serial_printf("kill_task(): Task %d is already terminated\n", pid);
     }
 
-    asm volatile("int $0x20");
+    task_yield();
 }
 
 // this function will never be called from kernel mode
@@ -253,12 +679,141 @@ void *malloc_int(uint32_t size) {
     return alloc(size, 0, tasks[crt_task].heap);
 }
 
-void free_int(void *ptr) {
+void *region_int(uint32_t size) {
+    if (size == 0 || crt_task == -1 || !tasks[crt_task].heap) {
+        return NULL;
+    }
+
+    if (size % PAGE_SIZE != 0) {
+        size += PAGE_SIZE - (size % PAGE_SIZE);
+    }
+
+    return alloc(size, 1, tasks[crt_task].heap);
+}
+
+// resizes a region of the current task, the result is still page aligned but may have moved
+void *resize_region_int(void *ptr, uint32_t size) {
+    if (size == 0 || crt_task == -1 || !tasks[crt_task].heap) {
+        return NULL;
+    }
+
+    heap_t *heap = tasks[crt_task].heap;
+    if (!heap_is_block(ptr, heap)) {
+        return NULL;
+    }
+
+    if (size % PAGE_SIZE != 0) {
+        size += PAGE_SIZE - (size % PAGE_SIZE);
+    }
+
+    return realloc(ptr, size, 1, heap);
+}
+
+// EINVAL for anything that isn't an allocated block of the task's heap, a second free included
+int free_int(void *ptr) {
     if (ptr == NULL || crt_task == -1 || !tasks[crt_task].heap) {
-        return;
+        return EINVAL;
+    }
+
+    if (!heap_is_block(ptr, tasks[crt_task].heap)) {
+        return EINVAL;
     }
 
     free(ptr, tasks[crt_task].heap);
+    return 0;
+}
+
+static void count_table(pagetab_t *tab, task_mem_t *st) {
+    st->page_tables++;
+
+    for (int i = 0; i < PAGE_TAB_SIZE; i++) {
+        page_t *page = &tab->pages[i];
+
+        if (page->present && page->frame) {
+            st->resident++;
+            if (frame_refs(page->frame) > 1) {
+                st->shared++;
+            }
+        } else if (page->swapped) {
+            st->swapped++;
+        }
+    }
+}
+
+/*
+    walks the tables of the task: the slot tables in kernel_dir (a slot covers two of them) and the
+    private tables of its directory (shm, file mappings). frames are counted where they are mapped,
+    so a shared frame shows up in every task that maps it
+*/
+void task_mem_usage(tcb_t *task, task_mem_t *st) {
+    memset(st, 0, sizeof(task_mem_t));
+
+    if (task->addr) {
+        uint32_t base = BIN_BASE_ADDR + task->addr->address_idx * MAX_PROCESS_SIZE;
+
+        for (uint32_t i = base / 0x400000; i < (base + MAX_PROCESS_SIZE) / 0x400000; i++) {
+            if (kernel_dir->tables[i]) {
+                count_table(kernel_dir->tables[i], st);
+            }
+        }
+    }
+
+    pagedir_t *dir = task->page_dir;
+    if (dir && dir != kernel_dir) {
+        st->page_tables++;
+
+        for (int i = 0; i < PAGE_DIR_SIZE; i++) {
+            if (dir->tables[i] && dir->tables[i] != kernel_dir->tables[i]) {
+                count_table(dir->tables[i], st);
+            }
+        }
+    }
+
+    if (task->heap) {
+        heap_usage(task->heap, &st->heap_used, &st->heap_free);
+    }
+
+    st->faults = task->faults;
+    st->major_faults = task->major_faults;
+}
+
+static void put_field(char *buf, uint32_t cap, uint32_t v) {
+    char num[12];
+    uitoa(num, v);
+
+    strlcat(buf, num, cap);
+    strlcat(buf, " ", cap);
+}
+
+/*
+    /dev/memstat: one line per task, the columns are
+    pid resident shared swapped heap_used heap_free page_tables faults major_faults
+*/
+uint32_t task_mem_read(struct file *file, uint32_t size, uint8_t *buffer) {
+    static char report[0x1000];
+    report[0] = 0;
+
+    for (int i = 0; i < ntasks; i++) {
+        if (tasks[i].state == TASK_TERMINATED || tasks[i].state == TASK_UNUSED) {
+            continue;
+        }
+
+        task_mem_t st;
+        task_mem_usage(&tasks[i], &st);
+
+        put_field(report, sizeof(report), tasks[i].pid);
+        put_field(report, sizeof(report), st.resident);
+        put_field(report, sizeof(report), st.shared);
+        put_field(report, sizeof(report), st.swapped);
+        put_field(report, sizeof(report), st.heap_used);
+        put_field(report, sizeof(report), st.heap_free);
+        put_field(report, sizeof(report), st.page_tables);
+        put_field(report, sizeof(report), st.faults);
+        put_field(report, sizeof(report), st.major_faults);
+        strlcat(report, "\n", sizeof(report));
+    }
+
+    return vfs_read_text(file, report, size, buffer);
 }
 
 void preempt_disable() {
@@ -273,7 +828,11 @@ void preempt_enable() {
     }
 }
 
-void do_schedule(regs_t *regs) {
+/*
+    tick is 0 for task_yield(). the running task gave the cpu up then, it is queued again without
+    being charged for a tick that didn't happen
+*/
+static void schedule(regs_t *regs, int tick) {
     asm volatile("cli");
 
     // save current interrupt frame to tcb
@@ -281,21 +840,43 @@ void do_schedule(regs_t *regs) {
         tasks[crt_task].regs = *regs;
     }
 
-    // wake up sleeping tasks
-    for (int i = 0; i < ntasks; i++) {
-        if (tasks[i].state == TASK_BLOCKED && tasks[i].sleep_expiry > 0){
-            tasks[i].sleep_expiry--;
-            if (tasks[i].sleep_expiry == 0) {
-                tasks[i].state = TASK_READY;
-            }
-        }
-    }
-
     if (crt_task != -1 && tasks[crt_task].preempt_count > 0) {
         asm volatile("sti");
         return;
     }
 
+    /*
+        the running task is charged a tick. it keeps the cpu until its quantum is used up, which
+        moves it a level down, or until a higher level has a ready task. then it goes to the back
+        of its queue, idle has minimum priority so it is never queued.
+        a real time task runs until its budget is gone or an earlier deadline is ready
+    */
+    if (crt_task > 0 && tasks[crt_task].state == TASK_RUNNING) {
+        tcb_t *task = &tasks[crt_task];
+
+        if (!tick) {
+            make_ready(task);
+        } else if (task->rt.period) {
+            if (++task->rt.used >= task->rt.budget) {
+                task->rt.throttled = 1;
+                task->state = TASK_BLOCKED;
+            } else if (edf_head && deadline_before(edf_head, task)) {
+                make_ready(task);
+            } else {
+                asm volatile("sti");
+                return;
+            }
+        } else if (--task->slice == 0) {
+            set_level(task, (task->prio < SCHED_NPRIO - 1) ? task->prio + 1 : task->prio);
+            make_ready(task);
+        } else if (edf_head || (runq_map & ((1 << task->prio) - 1))) {
+            make_ready(task);
+        } else {
+            asm volatile("sti");
+            return;
+        }
+    }
+
     int next = scheduler_pick_next();
 
     // idle task
@@ -303,17 +884,13 @@ void do_schedule(regs_t *regs) {
         next = 0;
     }
 
+    tasks[next].state = TASK_RUNNING;
+
     if (next == crt_task) {
         asm volatile("sti");
         return;
     }
 
-    // idle has minimum priority so it should never be set to ready.
-    if (crt_task != -1 && tasks[crt_task].state == TASK_RUNNING && tasks[crt_task].pid != 0) {
-        tasks[crt_task].state = TASK_READY;
-    }
-
-    tasks[next].state = TASK_RUNNING;
     crt_task = next;
 
     switch_page_dir(tasks[next].page_dir);
@@ -326,3 +903,16 @@ void do_schedule(regs_t *regs) {
         regs->esp = regs->useresp;
     }
 }
+
+// called by the pit on every tick
+void do_schedule(regs_t *regs) {
+    schedule(regs, 1);
+}
+
+static void yield_handler(regs_t *regs) {
+    schedule(regs, 0);
+}
+
+void task_yield() {
+    asm volatile("int %0" :: "i"(YIELD_VECTOR) : "memory");
+}
\ No newline at end of file
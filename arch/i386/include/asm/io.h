@@ -57,6 +57,8 @@
 #define PS2_MOUSE_BIT_YO    0x80
 
 #define PIT_SET  0x36
+#define PIT_ONESHOT 0x30 // channel 0, lo/hi byte, mode 0 (interrupt on terminal count)
+#define PIT_LATCH   0x00 // latch the channel 0 count
 #define PIT_DAT0 0x40
 #define PIT_DAT1 0x41
 #define PIT_DAT2 0x42
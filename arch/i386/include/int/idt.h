@@ -50,6 +50,7 @@ DECL_ISR(28);
 DECL_ISR(29);
 DECL_ISR(30);
 DECL_ISR(31);
+DECL_ISR(126);
 DECL_ISR(255);
 
 DECL_IRQ(0);
@@ -6,7 +6,7 @@ typedef uint32_t (*syscall_t)(uint32_t, uint32_t, uint32_t, uint32_t, uint32_t);
 
 uint32_t sys_exit(uint32_t ret, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4);
 uint32_t sys_write(uint32_t fd, uint32_t size, uint32_t buf, uint32_t unused1, uint32_t unused2);
-uint32_t sys_read(uint32_t fd, uint32_t size, uint32_t buf, uint32_t unused1, uint32_t unused2);
+uint32_t sys_read(uint32_t fd, uint32_t size, uint32_t buf, uint32_t offset, uint32_t unused1);
 uint32_t sys_open(uint32_t path, uint32_t mode, uint32_t unused1, uint32_t unused2, uint32_t unused3);
 uint32_t sys_malloc(uint32_t size, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4);
 uint32_t sys_free(uint32_t addr, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4);
@@ -18,6 +18,19 @@ uint32_t sys_get_state(uint32_t pid, uint32_t ptr, uint32_t unused1, uint32_t un
 uint32_t sys_get_display_info(uint32_t vbe_info_ptr, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4);
 uint32_t sys_request_buffer(uint32_t width, uint32_t height, uint32_t unused1, uint32_t unused2, uint32_t unused3);
 uint32_t sys_buffer_ready(uint32_t x, uint32_t y, uint32_t unused1, uint32_t unused2, uint32_t unused3);
+uint32_t sys_region(uint32_t size, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4);
+uint32_t sys_free_region(uint32_t addr, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4);
+uint32_t sys_shm_create(uint32_t size, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4);
+uint32_t sys_shm_map(uint32_t addr, uint32_t pid, uint32_t unused1, uint32_t unused2, uint32_t unused3);
+uint32_t sys_shm_unmap(uint32_t addr, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4);
+uint32_t sys_shm_destroy(uint32_t addr, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4);
+uint32_t sys_mmap(uint32_t user_path, uint32_t offset, uint32_t size, uint32_t unused1, uint32_t unused2);
+uint32_t sys_munmap(uint32_t addr, uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4);
+uint32_t sys_resize_region(uint32_t addr, uint32_t size, uint32_t unused1, uint32_t unused2, uint32_t unused3);
+uint32_t sys_mem_stats(uint32_t pid, uint32_t user_buffer, uint32_t unused1, uint32_t unused2, uint32_t unused3);
+uint32_t sys_set_nice(uint32_t pid, uint32_t nice, uint32_t unused1, uint32_t unused2, uint32_t unused3);
+uint32_t sys_set_rt(uint32_t pid, uint32_t period, uint32_t budget, uint32_t deadline, uint32_t unused1);
+uint32_t sys_rt_wait(uint32_t unused1, uint32_t unused2, uint32_t unused3, uint32_t unused4, uint32_t unused5);
 
 extern uint32_t NUM_SYSCALLS;
 
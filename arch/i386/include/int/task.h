@@ -1,11 +1,22 @@
 #pragma once
 
+#include <int/timer.h>
 #include <mm/kheap.h>
 #include <mm/paging.h>
 
 #define KERNEL_STACK_SIZE 4096
 #define MAX_TASKS 64
 
+#define SCHED_NPRIO       8 // mlfq levels, 0 is the highest
+#define SCHED_NICE_MAX    (SCHED_NPRIO - 1) // nice n keeps a task at level n or below
+#define SCHED_BOOST_TICKS 1000 // every task is lifted back to its top level this often
+
+#define SCHED_RT_MAX_UTIL   900 // permille of the cpu real time tasks can reserve, the rest is left to the mlfq
+#define SCHED_RT_MAX_PERIOD 10000 // ticks
+
+// software interrupt that reschedules without counting a tick, int 0x20 would run the pit handler
+#define YIELD_VECTOR 0x7E
+
 #define SIGKILL 1 // kill
 #define SIGSEGV 2 // segmentation fault
 #define SIGAFAIL 3 // assertion failed
@@ -14,7 +25,8 @@ typedef enum {
     TASK_READY,
     TASK_RUNNING,
     TASK_BLOCKED,
-    TASK_TERMINATED
+    TASK_TERMINATED,
+    TASK_UNUSED // slot in tasks[] is free
 } task_state_t;
 
 struct process_address_space { // ONLY FOR USER TASKS
@@ -31,17 +43,51 @@ struct process_address_space { // ONLY FOR USER TASKS
     uint32_t buffer_start;
 } __attribute__((packed));
 
+// memory used by a task, filled by task_mem_usage(). sizes are in pages unless noted
 typedef struct {
+    uint32_t resident; // frames mapped in the task's slot and private tables
+    uint32_t shared;   // resident frames with more than one reference (cow, page cache, shm)
+    uint32_t swapped;
+    uint32_t heap_used; // bytes
+    uint32_t heap_free; // bytes
+    uint32_t page_tables; // tables owned by the task, the directory included
+    uint32_t faults;
+    uint32_t major_faults; // faults that had to read from swap
+} task_mem_t;
+
+typedef struct tcb {
     uint8_t user; // 1 for user task, 0 for kernel task
     struct process_address_space *addr;
 
     uint32_t pid;
-    uint32_t sleep_expiry;
+    int parent; // task that created it, -1 for tasks created before tasking started
     uint32_t preempt_count;
 
+    uint8_t prio;
+    uint8_t nice;
+    uint8_t slice; // ticks left of the quantum at prio
+    struct tcb *next, *prev; // run queue links
+    ktimer_t sleep_timer;
+
+    // earliest deadline first class, period is 0 for normal tasks. times are in ticks
+    struct {
+        uint32_t period;
+        uint32_t budget;
+        uint32_t deadline; // relative to the release
+        uint32_t release; // start of the current period
+        uint32_t abs_deadline;
+        uint32_t used; // ticks run since the release
+        uint8_t throttled; // out of budget or done, waits for the next release
+        ktimer_t timer; // next release
+    } rt;
+
     regs_t regs;
     heap_t *heap;
     pagedir_t *page_dir;
+    struct vma *maps; // file mappings
+
+    uint32_t faults;
+    uint32_t major_faults;
 
     uint16_t buf_w, buf_h;
 
@@ -54,13 +100,24 @@ void init_tasking();
 int create_task(uint32_t eip);
 int create_user_task(struct process_address_space *addr);
 int scheduler_pick_next();
+int runq_empty();
+void task_sleep(uint32_t ticks);
+void task_block();
+void task_wake(int pid);
+int task_set_nice(int pid, int nice);
+int task_set_rt(int pid, uint32_t period, uint32_t budget, uint32_t deadline);
+void task_rt_wait();
 
 int getpid();
 tcb_t *get_task(int pid);
 
 void kill_task(int pid, int reason);
 
+void task_mem_usage(tcb_t *task, task_mem_t *st);
+uint32_t task_mem_read(struct file *file, uint32_t size, uint8_t *buffer);
+
 void preempt_disable();
 void preempt_enable();
 
-void do_schedule(regs_t *regs);
\ No newline at end of file
+void do_schedule(regs_t *regs);
+void task_yield();
\ No newline at end of file
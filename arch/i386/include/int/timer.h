@@ -4,9 +4,39 @@
 
 #define PIT_FREQUENCY 1193
 
+// timer wheel: a 256 slot wheel for the next 256 ticks, then 3 levels of 64 slots (2^26 ticks, ~18 hours at 1 khz)
+#define TIMER_ROOT_BITS 8
+#define TIMER_LVL_BITS  6
+#define TIMER_LEVELS    3
+#define TIMER_ROOT_SIZE (1 << TIMER_ROOT_BITS)
+#define TIMER_LVL_SIZE  (1 << TIMER_LVL_BITS)
+#define TIMER_MAX_DELTA ((1 << (TIMER_ROOT_BITS + TIMER_LEVELS * TIMER_LVL_BITS)) - 1)
+
+typedef void (*timer_fn_t)(void *arg);
+
+typedef struct ktimer {
+    uint32_t expires; // absolute tick
+    timer_fn_t fn;
+    void *arg;
+
+    struct ktimer *next, *prev;
+    struct ktimer **list; // list the timer is linked on, NULL when not armed
+} ktimer_t;
+
 void pit_install(uint32_t freq);
 
 void ksleep(uint32_t ms);
 uint32_t pit_get_ticks();
 
+void pit_idle_enter();
+void pit_idle_exit();
+
+void timer_init(ktimer_t *timer, timer_fn_t fn, void *arg);
+void timer_arm(ktimer_t *timer, uint32_t expires);
+int timer_cancel(ktimer_t *timer);
+int timer_pending(ktimer_t *timer);
+
+void timer_tick(uint32_t now);
+uint32_t timer_idle_ticks(uint32_t max);
+
 uint64_t rdtsc();
\ No newline at end of file
@@ -58,12 +58,12 @@ void serial_printf(const char *s, ...) {
 
             if (next == 'd') {
                 int arg = va_arg(list, int);
-                char ptr[10];
+                char ptr[12]; // sign, 10 digits
                 itoa(ptr, arg);
                 serial_puts(ptr);
             } else if (next == 'u') {
                 uint32_t arg = va_arg(list, uint32_t);
-                char ptr[9];
+                char ptr[11]; // up to 10 digits
                 uitoa(ptr, arg);
                 serial_puts(ptr);
             } else if (next == 'x') {
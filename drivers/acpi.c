@@ -62,13 +62,16 @@ void init_acpi() {
     #endif
 
     // the RSDT is never larger than a page 
-    map_memory(
+    if (map_memory(
         rsdp->RSDTAddress,
         rsdp->RSDTAddress,
         0x1000,
         kernel_dir,
         1, 0
-    );
+    ) != 0) {
+        serial_puts("RSDT mapping failed.\n");
+        return;
+    }
 
     struct RSDT *rsdt = (struct RSDT *) rsdp->RSDTAddress;
 
@@ -79,7 +82,10 @@ void init_acpi() {
     uint32_t first_entry = rsdt->pointerToOtherSDT[0];
 
     unmap_memory(rsdp->RSDTAddress, 0x1000, kernel_dir);
-    map_memory(first_entry, first_entry, 0x1000, kernel_dir, 1, 0);
+    if (map_memory(first_entry, first_entry, 0x1000, kernel_dir, 1, 0) != 0) {
+        serial_puts("SDT mapping failed.\n");
+        return;
+    }
 
     int entries = (rsdt->header.len - sizeof(rsdt->header)) / 4;
 
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <asm/io.h>
 #include <int/isr.h>
+#include <int/task.h>
 #include <video/vbe.h>
 
 const char sc_ascii_shift[] = {'?', '?', '!', '@', '#', '$', '%', '^',
@@ -33,6 +34,11 @@ _Bool reading = 0;
 // will be set to 1 when enter is pressed, and back to 0 when the buffer is read
 _Bool finished_reading = 0;
 
+// task blocked in read_buffer(), -1 if none
+static int reader = -1;
+
+extern volatile int crt_task;
+
 static void keyboard_callback(regs_t *regs) {
     uint8_t status;
     uint16_t scancode;
@@ -59,6 +65,10 @@ static void keyboard_callback(regs_t *regs) {
             reading = 0; // stop reading
             finished_reading = 1; // signal that we finished reading
             vesa_putc('\n');
+
+            if (reader != -1) {
+                task_wake(reader);
+            }
         }
 
         if (scancode <= 57 && sc_ascii[scancode] != '?') {
@@ -83,7 +93,21 @@ void read_buffer(file_t *unused, uint32_t size, uint8_t *dst) {
     reading = 1;
     finished_reading = 0;
 
-    while (!finished_reading) asm("hlt");
+    // the reader blocks until enter is pressed, waiting in hlt would count as cpu time and sink it in the mlfq
+    while (!finished_reading) {
+        if (crt_task > 0) {
+            asm volatile("cli");
+            if (!finished_reading) {
+                reader = crt_task;
+                task_block();
+                task_yield();
+            }
+            asm volatile("sti");
+        } else {
+            asm("hlt");
+        }
+    }
+    reader = -1;
 
     reading = 0;
     for (int i = 0; i < idx && i < size; i++) {
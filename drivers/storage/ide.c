@@ -102,6 +102,39 @@ uint32_t ata_write_bytes(struct file *file, uint32_t size, uint8_t *buffer) {
     return 0;
 }
 
+int ata_read_sectors(uint8_t drive, uint32_t lba, uint32_t count, uint8_t *buffer) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (ata_read_sector(drive, lba + i, buffer + i * ATA_SECTOR_SIZE) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int ata_write_sectors(uint8_t drive, uint32_t lba, uint32_t count, const uint8_t *buffer) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (ata_write_sector(drive, lba + i, buffer + i * ATA_SECTOR_SIZE) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// a missing device reads back as 0 or 0xFF (floating bus), identify would wait on it forever
+int ata_drive_present(uint8_t drive) {
+    outb(ATA_PRIMARY_IO_BASE + 6, 0xA0 | (drive << 4));
+
+    // ~400 ns for the drive select to settle
+    for (int i = 0; i < 4; i++) {
+        inb(ATA_PRIMARY_CTRL_BASE);
+    }
+
+    uint8_t status = inb(ATA_PRIMARY_IO_BASE + 7);
+    return status != 0 && status != 0xFF;
+}
+
 // returns the drive size in KiB
 uint32_t get_drive_size(uint8_t drive) {
     uint16_t buffer[256];
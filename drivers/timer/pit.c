@@ -13,10 +13,41 @@ extern uint8_t is_tasking_enabled;
 // max uptime ~49 days
 volatile uint32_t tick = 0;
 
+/*
+    the pit is periodic while something runs. the idle task switches it to one shot mode for the
+    time until the next timer (at most ~54 ms, the 16 bit counter), oneshot_ticks is the number of
+    ticks the shot stands for and 0 in periodic mode
+*/
+static uint32_t pit_div;
+static uint32_t oneshot_ticks = 0;
+static uint32_t oneshot_count;
+
+static void pit_program(uint8_t mode, uint32_t count) {
+    outb(PIT_CMD, mode);
+    outb(PIT_DAT0, count & 0xFF);
+    outb(PIT_DAT0, (count >> 8) & 0xFF);
+}
+
+static uint32_t pit_read() {
+    outb(PIT_CMD, PIT_LATCH);
+    uint32_t low = inb(PIT_DAT0);
+    uint32_t high = inb(PIT_DAT0);
+
+    return low | (high << 8);
+}
+
 static void pit_callback(regs_t *regs) {
-    tick++;
+    if (oneshot_ticks) {
+        tick += oneshot_ticks;
+        oneshot_ticks = 0;
+        pit_program(PIT_SET, pit_div);
+    } else {
+        tick++;
+    }
     irq_ack(0);
 
+    timer_tick(tick);
+
     if (!is_tasking_enabled) return;
 
     do_schedule(regs);
@@ -34,15 +65,13 @@ void ksleep(uint32_t ms) {
 
     asm volatile("cli");
 
-    tasks[crt_task].state = TASK_BLOCKED;
-    tasks[crt_task].sleep_expiry = ms;
+    task_sleep(ms); // one tick per ms
 
     #ifdef DEBUG
     serial_printf("sleep: crt_task = %d is yielding\n", crt_task);
     #endif
 
-    // yield
-    asm volatile("int $0x20"); // ensure atomic
+    task_yield();
     asm volatile("sti");
 
     return;
@@ -51,14 +80,51 @@ void ksleep(uint32_t ms) {
 void pit_install(uint32_t freq) {
     register_interrupt_handler(IRQ(0), pit_callback);
 
-    uint32_t div = 1193182 / freq;
-    outb(PIT_CMD, PIT_SET);
+    pit_div = 1193182 / freq;
+    pit_program(PIT_SET, pit_div);
+}
+
+// called by the idle task with interrupts off when no task is ready
+void pit_idle_enter() {
+    if (oneshot_ticks) {
+        return; // still lining up with the tick boundary after an early wake up
+    }
+
+    uint32_t ticks = timer_idle_ticks(0xFFFF / pit_div);
+    if (ticks <= 1) {
+        return;
+    }
+
+    oneshot_ticks = ticks;
+    oneshot_count = ticks * pit_div;
+    pit_program(PIT_ONESHOT, oneshot_count);
+}
+
+/*
+    the idle task woke up. if it was another interrupt the whole ticks that passed are accounted
+    now, and a last shot for the rest of the current tick keeps the old tick boundaries
+*/
+void pit_idle_exit() {
+    uint32_t eflags;
+    asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+
+    if (oneshot_ticks > 1) {
+        uint32_t left = pit_read();
+
+        // 0 or a wrapped counter: the shot expired and its irq is pending
+        if (left != 0 && left <= oneshot_count) {
+            uint32_t elapsed = oneshot_count - left;
 
-    uint8_t low = div & 0xFF;
-    uint8_t high = (div >> 8) & 0xFF;
+            tick += elapsed / pit_div;
+            timer_tick(tick);
+
+            oneshot_ticks = 1;
+            oneshot_count = pit_div - elapsed % pit_div;
+            pit_program(PIT_ONESHOT, oneshot_count);
+        }
+    }
 
-    outb(PIT_DAT0, low);
-    outb(PIT_DAT0, high);
+    asm volatile("push %0; popf" :: "r"(eflags) : "memory", "cc");
 }
 
 uint32_t pit_get_ticks() {
@@ -0,0 +1,182 @@
+#include <int/timer.h>
+
+/*
+    hierarchical timing wheel. timers due in the next 256 ticks sit in the root wheel, indexed by
+    their expiry tick. later ones go into one of the outer levels, each slot of level n covers
+    2^(8 + 6n) ticks. whenever the root wheel wraps, the current slot of the next level is emptied
+    and its timers are re-inserted one level further in (cascade), so arming, cancelling and
+    expiring are constant time and a tick only looks at a single slot.
+
+    every list is touched with interrupts off, the tick handler runs the callbacks
+*/
+
+static ktimer_t *root[TIMER_ROOT_SIZE];
+static ktimer_t *levels[TIMER_LEVELS][TIMER_LVL_SIZE];
+
+static uint32_t wheel_tick = 0; // next tick to be processed
+
+
+static inline uint32_t irq_save() {
+    uint32_t eflags;
+    asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+    return eflags;
+}
+
+static inline void irq_restore(uint32_t eflags) {
+    asm volatile("push %0; popf" :: "r"(eflags) : "memory", "cc");
+}
+
+static void link(ktimer_t *timer, ktimer_t **list) {
+    timer->prev = NULL;
+    timer->next = *list;
+    if (*list) {
+        (*list)->prev = timer;
+    }
+
+    *list = timer;
+    timer->list = list;
+}
+
+static void unlink(ktimer_t *timer) {
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        *timer->list = timer->next;
+    }
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+
+    timer->next = timer->prev = NULL;
+    timer->list = NULL;
+}
+
+static inline uint32_t lvl_index(uint32_t tick, int lvl) {
+    return (tick >> (TIMER_ROOT_BITS + lvl * TIMER_LVL_BITS)) & (TIMER_LVL_SIZE - 1);
+}
+
+// picks the slot from the distance to the deadline, deadlines in the past expire on the next tick
+static void insert(ktimer_t *timer) {
+    uint32_t expires = timer->expires;
+    int32_t delta = (int32_t) (expires - wheel_tick);
+
+    if (delta < 0) {
+        link(timer, &root[wheel_tick & (TIMER_ROOT_SIZE - 1)]);
+        return;
+    }
+
+    if (delta < TIMER_ROOT_SIZE) {
+        link(timer, &root[expires & (TIMER_ROOT_SIZE - 1)]);
+        return;
+    }
+
+    // too far away for the outermost level, it is re-inserted when its slot comes around
+    if ((uint32_t) delta > TIMER_MAX_DELTA) {
+        expires = wheel_tick + TIMER_MAX_DELTA;
+        delta = TIMER_MAX_DELTA;
+    }
+
+    int lvl = 0;
+    while (lvl < TIMER_LEVELS - 1 && (uint32_t) delta >= (1u << (TIMER_ROOT_BITS + (lvl + 1) * TIMER_LVL_BITS))) {
+        lvl++;
+    }
+
+    link(timer, &levels[lvl][lvl_index(expires, lvl)]);
+}
+
+// moves the timers of one outer slot a level in, returns the slot index so the caller knows when it wrapped
+static uint32_t cascade(int lvl) {
+    uint32_t idx = lvl_index(wheel_tick, lvl);
+    ktimer_t *timer = levels[lvl][idx];
+    levels[lvl][idx] = NULL;
+
+    while (timer) {
+        ktimer_t *next = timer->next;
+        timer->list = NULL;
+        insert(timer);
+        timer = next;
+    }
+
+    return idx;
+}
+
+void timer_init(ktimer_t *timer, timer_fn_t fn, void *arg) {
+    timer->expires = 0;
+    timer->fn = fn;
+    timer->arg = arg;
+    timer->next = timer->prev = NULL;
+    timer->list = NULL;
+}
+
+// arms the timer for an absolute tick, an armed timer is moved to the new deadline
+void timer_arm(ktimer_t *timer, uint32_t expires) {
+    uint32_t eflags = irq_save();
+
+    if (timer->list) {
+        unlink(timer);
+    }
+
+    timer->expires = expires;
+    insert(timer);
+
+    irq_restore(eflags);
+}
+
+// returns 1 if the timer was armed
+int timer_cancel(ktimer_t *timer) {
+    uint32_t eflags = irq_save();
+
+    int armed = timer->list != NULL;
+    if (armed) {
+        unlink(timer);
+    }
+
+    irq_restore(eflags);
+    return armed;
+}
+
+int timer_pending(ktimer_t *timer) {
+    return timer->list != NULL;
+}
+
+// called from the pit handler with the current tick, catches up if ticks were missed
+void timer_tick(uint32_t now) {
+    while ((int32_t) (now - wheel_tick) >= 0) {
+        uint32_t idx = wheel_tick & (TIMER_ROOT_SIZE - 1);
+
+        // the root wheel wrapped, pull the next slot of the outer levels in
+        if (idx == 0) {
+            for (int lvl = 0; lvl < TIMER_LEVELS && cascade(lvl) == 0; lvl++);
+        }
+
+        ktimer_t *timer = root[idx];
+        root[idx] = NULL;
+        wheel_tick++;
+
+        while (timer) {
+            ktimer_t *next = timer->next;
+            timer->next = timer->prev = NULL;
+            timer->list = NULL;
+
+            timer->fn(timer->arg);
+
+            timer = next;
+        }
+    }
+}
+
+/*
+    number of ticks until the first one the wheel has work for (an expiry or a cascade), at most max.
+    wheel_tick is the tick after the last processed one, timers due there need the very next tick
+*/
+uint32_t timer_idle_ticks(uint32_t max) {
+    for (uint32_t k = 0; k < max; k++) {
+        uint32_t idx = (wheel_tick + k) & (TIMER_ROOT_SIZE - 1);
+
+        if (idx == 0 || root[idx]) {
+            return k + 1;
+        }
+    }
+
+    return max;
+}
\ No newline at end of file
@@ -5,11 +5,25 @@
 #include <hw/ata.h>
 #include <asm/io.h>
 #include <mm/kheap.h>
+#include <mm/slab.h>
+#include <mm/pcache.h>
 #include <fs/skbdfs.h>
 
 
 extern uint64_t fs_size;
 
+kmem_cache_t *file_cache;
+kmem_cache_t *node_cache;
+kmem_cache_t *block_cache;
+
+void init_skbdfs() {
+    file_cache = kmem_cache_create("file_t", sizeof(file_t), 0, NULL);
+    node_cache = kmem_cache_create("node_t", sizeof(node_t), 0, NULL);
+    block_cache = kmem_cache_create("block_t", BLOCK_SIZE, 0, NULL);
+
+    init_pcache();
+}
+
 uint8_t mode_calc(uint8_t user, uint8_t kernel) {
     return user << 3 | kernel;
 }
@@ -32,7 +46,7 @@ static void __file_unlock(file_t *file) {
 static uint32_t find_next_free_block(block_t *dest, uint32_t iblk) {
     uint64_t offset = iblk * BLOCK_SIZE;
 
-    block_t *blk = (block_t *) kmalloc(BLOCK_SIZE);
+    block_t *blk = (block_t *) kmem_cache_alloc(block_cache);
 
     while (offset < fs_size) {
         file_t temp;
@@ -45,20 +59,20 @@ static uint32_t find_next_free_block(block_t *dest, uint32_t iblk) {
             if (dest != NULL) {
                 memcpy(dest, blk, BLOCK_SIZE);
             }
-            kfree(blk);
+            kmem_cache_free(block_cache, blk);
             return offset / BLOCK_SIZE;
         }
 
         offset += BLOCK_SIZE;
     }
 
-    kfree(blk);
+    kmem_cache_free(block_cache, blk);
     return 0;
 }
 
 static block_t *get_block_by_index(uint32_t iblk) {
     uint64_t offset = iblk * BLOCK_SIZE;
-    block_t *blk = (block_t *) kmalloc(BLOCK_SIZE);
+    block_t *blk = (block_t *) kmem_cache_alloc(block_cache);
 
     file_t temp;
     temp.ptr_global = offset;
@@ -121,12 +135,12 @@ uint32_t find_node(char *path, int type, int parent, node_t *dst) {
 
                     children = (uint32_t *) (blk.data + sizeof(node_t));
 
-                    kfree(b);
+                    kmem_cache_free(block_cache, b);
                     break;
                 }
             }
 
-            kfree(b);
+            kmem_cache_free(block_cache, b);
             children++;
         }
 
@@ -143,10 +157,10 @@ uint32_t find_node(char *path, int type, int parent, node_t *dst) {
 }
 
 node_t *mknode(char *path, int type) {
-    node_t *node = (node_t *) kmalloc(sizeof(node_t));
+    node_t *node = (node_t *) kmem_cache_alloc(node_cache);
     uint32_t block_offset = find_node(path, FS_DIR, 1, node);
     if (block_offset == 0) {
-        kfree(node);
+        kmem_cache_free(node_cache, node);
         return NULL;
     }
 
@@ -167,8 +181,7 @@ node_t *mknode(char *path, int type) {
     uint32_t parent_size = node->size;
     uint32_t parent_off = node->first_block;
 
-    block_t *block = (block_t *) kmalloc(BLOCK_SIZE);
-    uint32_t r = find_next_free_block(block, block_offset);
+    uint32_t r = find_next_free_block(NULL, block_offset);
     assert(r > 0);
 
     memcpy(blk->data + sizeof(node_t) + node->size * 4, &r, 4);
@@ -202,16 +215,16 @@ node_t *mknode(char *path, int type) {
     tempf.ptr_global = r * BLOCK_SIZE;
     ata_write_bytes(&tempf, BLOCK_SIZE, (uint8_t *) blk);
 
-    kfree(blk);
+    kmem_cache_free(block_cache, blk);
     return node;
 }
 
 node_t **listdir(char *path) {
-    node_t *node = (node_t *) kmalloc(sizeof(node_t));
+    node_t *node = (node_t *) kmem_cache_alloc(node_cache);
     uint32_t off = find_node(path, FS_DIR, 0, node);
 
     if (off == 0) {
-        kfree(node);
+        kmem_cache_free(node_cache, node);
         return NULL; // directory not found
     }
 
@@ -220,14 +233,14 @@ node_t **listdir(char *path) {
     uint32_t *child_indices = (uint32_t *) (blk->data + sizeof(node_t));
 
     for (int i = 0; i < node->size; i++) {
-        children[i] = (node_t *) kmalloc(sizeof(node_t));
+        children[i] = (node_t *) kmem_cache_alloc(node_cache);
         block_t *child_blk = get_block_by_index(child_indices[i]);
         memcpy(children[i], child_blk->data, sizeof(node_t));
-        kfree(child_blk);
+        kmem_cache_free(block_cache, child_blk);
     }
 
-    kfree(blk);
-    kfree(node);
+    kmem_cache_free(block_cache, blk);
+    kmem_cache_free(node_cache, node);
 
     return children;
 }
@@ -236,8 +249,8 @@ node_t **listdir(char *path) {
 file_t *fopen(char *path, uint8_t mode) {
     if (mode == 0) return NULL;
 
-    node_t *node = (node_t *) kmalloc(sizeof(node_t));
-    file_t *file = (file_t *) kmalloc(sizeof(file_t));
+    node_t *node = (node_t *) kmem_cache_alloc(node_cache);
+    file_t *file = (file_t *) kmem_cache_alloc(file_cache);
     if (!node || !file) {
         #ifdef DEBUG
         serial_printf("fopen: kmalloc failed\n");
@@ -245,17 +258,18 @@ file_t *fopen(char *path, uint8_t mode) {
         return NULL;
     }
 
+    file->type = FILE_NORMAL;
     uint32_t off = find_node(path, FS_FILE, 0, node);
 
     if (mode & FMODE_W) {
         if (off == 0) { // file does not exist
-            kfree(node); // free old node
+            kmem_cache_free(node_cache, node); // free old node
             node = mknode(path, FS_FILE);
         }
 
         if ((node->mode & MODE_W) == 0) {
-            kfree(node);
-            kfree(file);
+            kmem_cache_free(node_cache, node);
+            kmem_cache_free(file_cache, file);
             return NULL; // not writeable
         }
 
@@ -266,13 +280,13 @@ file_t *fopen(char *path, uint8_t mode) {
         file->ptr_global = BLOCK_SIZE * node->first_block;
     } else if (mode & FMODE_A) { // append
         if (off == 0) { // file does not exist
-            kfree(node);
+            kmem_cache_free(node_cache, node);
             node = mknode(path, FS_FILE);
         }
 
         if ((node->mode & MODE_W) == 0) {
-            kfree(node);
-            kfree(file);
+            kmem_cache_free(node_cache, node);
+            kmem_cache_free(file_cache, file);
             return NULL;
         }
 
@@ -281,10 +295,11 @@ file_t *fopen(char *path, uint8_t mode) {
         int next = node->first_block;
         while (block->next != 0) {
             next = block->next;
-            kfree(block);
+            kmem_cache_free(block_cache, block);
 
-            block = get_block_by_index(block->next);
+            block = get_block_by_index(next);
         }
+        kmem_cache_free(block_cache, block);
 
         file->node = node;
         file->mode = mode;
@@ -298,8 +313,8 @@ file_t *fopen(char *path, uint8_t mode) {
             serial_printf("fopen: File %s doesn't exist\n", path);
             #endif
 
-            kfree(node);
-            kfree(file);
+            kmem_cache_free(node_cache, node);
+            kmem_cache_free(file_cache, file);
             return NULL;
         }
 
@@ -314,8 +329,10 @@ file_t *fopen(char *path, uint8_t mode) {
 }
 
 void fclose(file_t *file) {
-    kfree(file->node);
-    kfree(file);
+    if (file->type == FILE_NORMAL) {
+        kmem_cache_free(node_cache, file->node);
+    }
+    kmem_cache_free(file_cache, file);
 
     return;
 }
@@ -353,6 +370,7 @@ int fread(file_t *file, uint32_t size, uint8_t *buffer) {
         file->ptr_global += size;
 
         __file_unlock(file);
+        kmem_cache_free(block_cache, crt_block);
         return 0;
     }
 
@@ -366,11 +384,12 @@ int fread(file_t *file, uint32_t size, uint8_t *buffer) {
     for (int i = 0; i < temp; i++) {
         if (crt_block->next == 0) {
             __file_unlock(file);
+            kmem_cache_free(block_cache, crt_block);
             return -1; // I/O error
         }
 
         // find next block
-        kfree(crt_block);
+        kmem_cache_free(block_cache, crt_block);
         crt_block = get_block_by_index(next);
         memcpy(buffer, crt_block->data, BLOCK_DATA_SIZE);
 
@@ -384,11 +403,12 @@ int fread(file_t *file, uint32_t size, uint8_t *buffer) {
     if (size > 0) {
         if (crt_block->next == 0) {
             __file_unlock(file);
+            kmem_cache_free(block_cache, crt_block);
             return -1; // I/O error
         }
 
         int next = crt_block->next;
-        kfree(crt_block);
+        kmem_cache_free(block_cache, crt_block);
         crt_block = get_block_by_index(next);
         memcpy(buffer, crt_block->data, size);
     }
@@ -398,15 +418,69 @@ int fread(file_t *file, uint32_t size, uint8_t *buffer) {
    
     __file_unlock(file);
 
-    kfree(crt_block);
+    kmem_cache_free(block_cache, crt_block);
     return 0;
 }
 
+/*
+    reads from a file without a file_t or a seek pointer, used to fill the page cache.
+    returns the number of bytes read, less than size at the end of the file
+*/
+int fread_at(node_t *node, uint32_t off, uint32_t size, uint8_t *buffer) {
+    if (off >= node->size) {
+        return 0;
+    }
+    if (size > node->size - off) {
+        size = node->size - off;
+    }
+
+    // the first block of the file contains metadata
+    uint32_t offset = off + sizeof(node_t);
+    uint32_t nblocks_real = offset / BLOCK_DATA_SIZE;
+    uint32_t off_crt_block = offset % BLOCK_DATA_SIZE;
+
+    block_t *crt_block = (block_t *) kmem_cache_alloc(block_cache);
+    read_block_into(node->first_block, crt_block);
+
+    for (uint32_t i = 0; i < nblocks_real; i++) {
+        if (crt_block->next == 0) {
+            kmem_cache_free(block_cache, crt_block);
+            return -1; // I/O error
+        }
+        read_block_into(crt_block->next, crt_block);
+    }
+
+    uint32_t done = 0;
+    while (done < size) {
+        uint32_t n = BLOCK_DATA_SIZE - off_crt_block;
+        if (n > size - done) {
+            n = size - done;
+        }
+
+        memcpy(buffer + done, crt_block->data + off_crt_block, n);
+        done += n;
+        off_crt_block = 0;
+
+        if (done < size) {
+            if (crt_block->next == 0) {
+                break;
+            }
+            read_block_into(crt_block->next, crt_block);
+        }
+    }
+
+    kmem_cache_free(block_cache, crt_block);
+    return done;
+}
+
 int fwrite(file_t *file, uint32_t size, uint8_t *buffer) {
     if ((file->node->mode & MODE_W) == 0) {
         return -1; // file is readonly
     }
 
+    // cached pages of the file would go stale, existing mappings keep the old contents
+    pcache_invalidate(file->node->first_block);
+
     if ((file->mode & FMODE_A) != 0) {
         // append (can only append to end of file.)
 
@@ -445,7 +519,7 @@ int fwrite(file_t *file, uint32_t size, uint8_t *buffer) {
             &tempf,
             BLOCK_SIZE, (uint8_t *) first_blk
         );
-        kfree(first_blk);
+        kmem_cache_free(block_cache, first_blk);
     }
 
     // write single block
@@ -461,7 +535,7 @@ int fwrite(file_t *file, uint32_t size, uint8_t *buffer) {
         file->ptr_global += size;
         file->ptr_local += size;
         
-        kfree(crt_block);
+        kmem_cache_free(block_cache, crt_block);
 
         __file_unlock(file);
         return 0;
@@ -487,7 +561,7 @@ int fwrite(file_t *file, uint32_t size, uint8_t *buffer) {
     // set block as not free, so its not detected by find_next_free_block
     tempf.ptr_global = next_idx * BLOCK_SIZE + 4;
     ata_write_bytes(&tempf, 1, buff);
-    kfree(crt_block);
+    kmem_cache_free(block_cache, crt_block);
 
     file->ptr_local += BLOCK_DATA_SIZE - off_crt_block;
     buffer += BLOCK_DATA_SIZE - off_crt_block;
@@ -522,7 +596,7 @@ int fwrite(file_t *file, uint32_t size, uint8_t *buffer) {
         buffer += BLOCK_DATA_SIZE;
         size -= BLOCK_DATA_SIZE;
 
-        kfree(crt_block);
+        kmem_cache_free(block_cache, crt_block);
     }
 
     // write last block
@@ -540,6 +614,7 @@ int fwrite(file_t *file, uint32_t size, uint8_t *buffer) {
         );
 
         file->ptr_local += size;
+        kmem_cache_free(block_cache, crt_block);
     }
 
     file->ptr_global = next_idx * BLOCK_SIZE + size;
@@ -568,10 +643,12 @@ int fseek(file_t *file, uint32_t n, uint8_t mode) {
         block_t *blk = get_block_by_index(file->node->first_block);
         int next = blk->next;
         while (i > 0) {
+            kmem_cache_free(block_cache, blk);
             blk = get_block_by_index(next);
             next = blk->next;
             i--;
         }
+        kmem_cache_free(block_cache, blk);
 
         file->ptr_global = next * BLOCK_SIZE + n % BLOCK_DATA_SIZE;
     }
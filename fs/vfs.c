@@ -1,6 +1,8 @@
 #include <fs/vfs.h>
 #include <hw/ata.h>
 #include <asm/io.h>
+#include <int/task.h>
+#include <int/syscall.h>
 
 #include <stdio.h>
 #include <string.h>
@@ -38,7 +40,7 @@ struct file *dev_by_idx(uint8_t idx) {
         return NULL;
     } 
 
-    struct file *ret = (struct file *) kmalloc(sizeof(struct file));
+    struct file *ret = (struct file *) kmem_cache_alloc(file_cache);
 
     ret->type = FILE_DEVICE;
     ret->device = mounts[idx].dev;
@@ -51,6 +53,7 @@ struct file *dev_by_idx(uint8_t idx) {
 
 void init_vfs() {
     memset(&mounts, 0, sizeof(mounts));
+    init_skbdfs();
 
     mounts[0].dev = (vfs_device_t *) kmalloc(sizeof(vfs_device_t));
     mounts[0].path = "/dev/ide";
@@ -79,6 +82,20 @@ void init_vfs() {
     mounts[3].dev->read = read_buffer;
     mounts[3].dev->write = NULL;
     mounts[3].flags = MODE_R;
+
+    mounts[4].dev = (vfs_device_t *) kmalloc(sizeof(vfs_device_t));
+    mounts[4].path = "/dev/kheap";
+    mounts[4].dev->open = NULL;
+    mounts[4].dev->read = heap_stats_read;
+    mounts[4].dev->write = heap_stats_write;
+    mounts[4].flags = MODE_R | MODE_W;
+
+    mounts[5].dev = (vfs_device_t *) kmalloc(sizeof(vfs_device_t));
+    mounts[5].path = "/dev/memstat";
+    mounts[5].dev->open = NULL;
+    mounts[5].dev->read = task_mem_read;
+    mounts[5].dev->write = NULL;
+    mounts[5].flags = MODE_R;
 }
 
 struct file *vfs_open(char *path, uint8_t mode) {
@@ -131,4 +148,29 @@ int vfs_read(struct file *file, uint32_t size, uint8_t *buffer) {
     }
 
     return -2;
+}
+
+/*
+    read helper for devices whose contents are generated on every read (/dev/kheap, /dev/memstat).
+    the handle from dev_by_idx lives for one syscall, so nothing is kept between reads:
+    file->ptr_local is the offset the caller passed to sys_read and the caller advances it.
+    returns the number of bytes copied, 0 past the end and -1 if the user buffer is bad.
+*/
+uint32_t vfs_read_text(struct file *file, const char *text, uint32_t size, uint8_t *buffer) {
+    uint32_t len = strlen(text);
+
+    if (file->ptr_local >= len) {
+        return 0;
+    }
+
+    uint32_t n = len - file->ptr_local;
+    if (n > size) {
+        n = size;
+    }
+
+    if (copy_to_user(buffer, (void *) (text + file->ptr_local), n) != 0) {
+        return (uint32_t) -1;
+    }
+
+    return n;
 }
\ No newline at end of file
@@ -5,4 +5,5 @@
 
 void destroy_process(struct process_address_space *s);
 struct process_address_space *load(char *path, _Bool has_buffer);
+int bin_fault(uint32_t addr);
 
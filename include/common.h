@@ -11,6 +11,8 @@
 
 #define VESA_MODE
 
+#define HEAP_STATS // per heap usage counters and call site attribution, see /dev/kheap
+
 #define PAGE_SIZE 0x1000
 
 #define BIN_BASE_ADDR   0x40000000
@@ -4,6 +4,7 @@
 #define ENOENT  0x02 // No such file or directory
 #define ESRCH   0x03 // No such process
 #define EIO     0x05 // I/O error
+#define EBUSY   0x10 // Device or resource busy
 #define ENOMEM  0x12 // Not enough space in memory
 #define ENODEV  0x13 // No such device
 #define EFAULT  0x14 // Bad address
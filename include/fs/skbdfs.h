@@ -2,6 +2,7 @@
 
 #include <common.h>
 #include <fs/vfs.h>
+#include <mm/slab.h>
 
 #define FS_DIR      (1 << 0)
 #define FS_FILE     (1 << 1)
@@ -92,6 +93,12 @@ typedef struct file {
     uint8_t mode : 3;
 } file_t;
 
+extern kmem_cache_t *file_cache;
+extern kmem_cache_t *node_cache;
+extern kmem_cache_t *block_cache;
+
+void init_skbdfs();
+
 node_t *mknode(char *path, int type);
 file_t *fopen(char *path, uint8_t mode);
 void fclose(file_t *file);
@@ -101,5 +108,6 @@ node_t **listdir(char *path);
 int fseek(file_t *file, uint32_t n, uint8_t mode);
 int fread(file_t *file, uint32_t size, uint8_t *buffer);
 int fwrite(file_t *file, uint32_t size, uint8_t *buffer);
+int fread_at(node_t *node, uint32_t off, uint32_t size, uint8_t *buffer);
 
 uint32_t find_node(char *path, int type, int parent, node_t *dst);
\ No newline at end of file
@@ -22,4 +22,6 @@ struct file *dev_by_idx(uint8_t idx);
 
 struct file *vfs_open(char *path, uint8_t mode);
 int vfs_read(struct file *file, uint32_t size, uint8_t *buffer);
-int vfs_write(struct file *file, uint32_t size, uint8_t *buffer);
\ No newline at end of file
+int vfs_write(struct file *file, uint32_t size, uint8_t *buffer);
+
+uint32_t vfs_read_text(struct file *file, const char *text, uint32_t size, uint8_t *buffer);
\ No newline at end of file
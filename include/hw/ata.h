@@ -14,4 +14,9 @@
 
 uint32_t ata_read_bytes(struct file *file, uint32_t size, uint8_t *buffer);
 uint32_t ata_write_bytes(struct file *file, uint32_t size, uint8_t *buffer);
-uint32_t get_drive_size(uint8_t drive);
\ No newline at end of file
+uint32_t get_drive_size(uint8_t drive);
+int ata_drive_present(uint8_t drive);
+
+// raw sector access, used by swap
+int ata_read_sectors(uint8_t drive, uint32_t lba, uint32_t count, uint8_t *buffer);
+int ata_write_sectors(uint8_t drive, uint32_t lba, uint32_t count, const uint8_t *buffer);
\ No newline at end of file
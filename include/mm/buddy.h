@@ -0,0 +1,34 @@
+#pragma once
+
+#include <common.h>
+
+#define BUDDY_MAX_ORDER 10 // 4 mb blocks
+#define FRAME_NONE      0xFFFFFFFF
+
+#define FRAME_FREE      (1 << 0) // head of a free block
+#define FRAME_RESERVED  (1 << 1) // never handed to the allocator
+
+typedef struct {
+    // free list links (frame indices), only valid while FRAME_FREE is set
+    uint32_t next;
+    uint32_t prev;
+
+    uint8_t order;
+    uint8_t flags;
+    uint16_t refs; // number of mappings of an allocated frame
+} frame_t;
+
+extern uint32_t nframes;
+extern uint32_t free_frames;
+
+void init_buddy(uint32_t n);
+void buddy_add_range(uint32_t frame, uint32_t count);
+
+uint32_t buddy_alloc(uint32_t order);
+void buddy_free(uint32_t frame, uint32_t order);
+
+void frame_ref(uint32_t frame);
+uint32_t frame_unref(uint32_t frame);
+uint32_t frame_refs(uint32_t frame);
+
+void buddy_dump();
\ No newline at end of file
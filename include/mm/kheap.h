@@ -1,19 +1,26 @@
 #pragma once
 
 #include <common.h>
-#include <ordered_array.h>
 
 
 #define KHEAP_START      0xC0000000
 #define KHEAP_INITIAL_SZ 0x100000
-#define HEAP_INDEX_SZ    0x20000
+#define USER_HEAP_INITIAL_SZ 0x4000 // user heaps grow from a few pages
 #define HEAP_MAGIC       0x69694200
 #define HEAP_MIN_SZ      0x70000
+#define HEAP_NBINS       32
+#define HEAP_NSITES      64   // call sites tracked per heap
+#define HEAP_SITE_NONE   0xFF // block not attributed to a site (table full or stats disabled)
 
-typedef struct {
+typedef struct header {
     uint32_t magic;
     uint8_t hole;
+    uint8_t site; // index into heap_stats_t.sites, fits in the padding after hole
     uint32_t size;
+
+    // free list links, only valid while hole = 1
+    struct header *next;
+    struct header *prev;
 } header_t;
 
 typedef struct {
@@ -22,14 +29,45 @@ typedef struct {
 } footer_t;
 
 typedef struct {
-    ordered_array_t index;
+    uint32_t addr;  // return address of the allocating call
+    uint32_t live;  // blocks from this site that are still allocated
+    uint32_t bytes; // bytes held by those blocks, headers included
+    uint32_t calls;
+} heap_site_t;
+
+typedef struct {
+    uint32_t live;
+    uint32_t used; // bytes in allocated blocks, headers included
+    uint32_t peak;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t expands;
+    uint32_t contracts;
+    heap_site_t sites[HEAP_NSITES];
+} heap_stats_t;
+
+typedef struct {
+    /*
+        segregated free lists, bins[i] holds the holes with size in [2^i, 2^(i+1)).
+        bit i of binmap is set if bins[i] is not empty
+    */
+    header_t *bins[HEAP_NBINS];
+    uint32_t binmap;
+
     uint32_t start;
     uint32_t end;
     uint32_t max;
+    uint32_t min; // contract() never shrinks the heap below this size
     uint8_t supervisor;
     uint8_t ro;
+
+#ifdef HEAP_STATS
+    heap_stats_t stats;
+#endif
 } heap_t;
 
+struct file;
+
 uint32_t kmalloc_int(uint32_t sz, int align, uint32_t *phy);
 uint32_t kmalloc_a(uint32_t sz);
 uint32_t kmalloc_p(uint32_t sz, uint32_t *phy);
@@ -41,5 +79,14 @@ void *alloc(uint32_t size, uint8_t align, heap_t *heap);
 
 void free(void *p, heap_t *heap);
 void kfree(void *p);
+int heap_is_block(void *p, heap_t *heap);
+
+void *realloc(void *p, uint32_t size, uint8_t align, heap_t *heap);
+void *krealloc(void *p, uint32_t sz);
+
+void *kcalloc(uint32_t nmemb, uint32_t sz);
 
-void *kcalloc(uint32_t nmemb, uint32_t sz);
\ No newline at end of file
+void heap_usage(heap_t *heap, uint32_t *used, uint32_t *free_bytes);
+void heap_dump(heap_t *heap);
+uint32_t heap_stats_read(struct file *file, uint32_t size, uint8_t *buffer);
+uint32_t heap_stats_write(struct file *file, uint32_t size, uint8_t *buffer);
\ No newline at end of file
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <common.h>
+
+// temporary mappings of arbitrary physical frames, the window is the last 4 mib of the address space
+#define KMAP_BASE  0xFFC00000
+#define KMAP_SLOTS 2
+
+#define KMAP_SRC 0
+#define KMAP_DST 1
+
+void init_kmap();
+
+void *kmap(uint32_t frame, int slot);
+void kunmap(int slot);
+
+void copy_frame(uint32_t dst, uint32_t src);
+void zero_frame(uint32_t frame);
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <common.h>
+#include <fs/skbdfs.h>
+
+// read only file mappings, every task has its own page tables for this region
+#define MMAP_BASE 0xA0000000
+#define MMAP_END  0xC0000000
+
+typedef struct vma {
+    uint32_t start;
+    uint32_t end;
+    uint32_t offset; // file offset of start, page aligned
+    node_t *node;
+
+    struct vma *next; // sorted by address
+} vma_t;
+
+struct tcb;
+
+uint32_t mmap_file(struct tcb *task, char *path, uint32_t offset, uint32_t size);
+int munmap_file(struct tcb *task, uint32_t addr);
+int mmap_fault(uint32_t addr);
+void mmap_release(struct tcb *task);
@@ -1,17 +1,37 @@
 #pragma once
 
 #include <int/isr.h>
+#include <multiboot.h>
 
 #define PAGE_DIR_SIZE 1024
 #define PAGE_TAB_SIZE 1024
 
+// page directory entry flags
+#define PDE_PRESENT 0x01
+#define PDE_RW      0x02
+#define PDE_USER    0x04
+#define PDE_LARGE   0x80 // 4 mib page (pse), the entry has no page table
+#define PDE_GLOBAL  0x100 // only valid together with PDE_LARGE
+
+#define DIR_POOL_SIZE 4 // page directories kept ready for new tasks
+
+// page tables and directories live in their own frames, mapped into this window (4 mib below the kmap window)
+#define PT_WINDOW_BASE  0xFF800000
+#define PT_WINDOW_SLOTS 1024
+
 typedef struct {
     uint32_t present  : 1;
     uint32_t rw       : 1;
     uint32_t user     : 1;
+    uint32_t pwt      : 1; // write through
+    uint32_t pcd      : 1; // cache disable
     uint32_t accessed : 1;
     uint32_t dirty    : 1;
-    uint32_t unused   : 7;
+    uint32_t pat      : 1;
+    uint32_t global   : 1;
+    uint32_t cow      : 1; // available to the os: read only because the frame is shared, copy on write
+    uint32_t swapped  : 1; // available to the os: not present, frame holds the swap slot
+    uint32_t avail    : 1;
     uint32_t frame    : 20;
 } page_t;
 
@@ -21,19 +41,40 @@ typedef struct {
 
 typedef struct {
     pagetab_t *tables[PAGE_DIR_SIZE];
-    uint32_t tab_phy[PAGE_DIR_SIZE];
+    uint32_t *tab_phy; // the directory the cpu sees, one page
     uint32_t addr;
 } pagedir_t;
 
 extern pagedir_t *crt_dir;
 extern pagedir_t *kernel_dir;
 
-void init_paging();
+// drops a single translation, global ones included
+static inline void flush_page(uint32_t vaddr) {
+    asm volatile("invlpg (%0)" :: "r"(vaddr) : "memory");
+}
+
+// drops every non global translation
+static inline void flush_tlb() {
+    uint32_t cr3;
+    asm volatile("mov %%cr3, %0" : "=r"(cr3));
+    asm volatile("mov %0, %%cr3" :: "r"(cr3) : "memory");
+}
+
+void init_paging(struct mboot_info *mboot);
 void switch_page_dir(pagedir_t *dir);
 page_t *get_page(uint32_t addr, int make, pagedir_t *dir);
+uint32_t get_phys(uint32_t vaddr, pagedir_t *dir);
 void pgf(regs_t *regs);
+uint32_t take_frame();
 void alloc_frame(page_t *page, int kernel, int writable);
+void alloc_frame_zeroed(page_t *page, int kernel, int writable);
 void free_frame(page_t *page);
+int map_frames(uint32_t vaddr, uint32_t size, int kernel, int writable, pagedir_t *dir);
 pagedir_t *clone_dir(pagedir_t *src);
-void map_memory(uint32_t addr, uint32_t vaddr, uint32_t size, pagedir_t *dir, int use_existing_phys, uint8_t user);
+pagetab_t *alloc_table(uint32_t *phys);
+void free_table(pagetab_t *tab);
+pagedir_t *alloc_dir();
+void free_dir(pagedir_t *dir);
+void dir_pool_refill();
+int map_memory(uint32_t addr, uint32_t vaddr, uint32_t size, pagedir_t *dir, int use_existing_phys, uint8_t user);
 void unmap_memory(uint32_t vaddr, uint32_t size, pagedir_t *dir);
\ No newline at end of file
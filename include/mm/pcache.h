@@ -0,0 +1,27 @@
+#pragma once
+
+#include <common.h>
+#include <fs/skbdfs.h>
+
+#define PCACHE_BUCKETS 64
+
+// one cached page of a file, files are identified by the index of their first block
+typedef struct pcache_entry {
+    uint32_t ino;
+    uint32_t index; // page index inside the file
+    uint32_t frame;
+
+    struct pcache_entry *next;
+} pcache_entry_t;
+
+extern uint32_t pcache_hits;
+extern uint32_t pcache_misses;
+extern uint32_t pcache_pages;
+
+void init_pcache();
+
+uint32_t pcache_get(node_t *node, uint32_t index);
+void pcache_invalidate(uint32_t ino);
+uint32_t pcache_shrink();
+
+void pcache_dump();
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <common.h>
+#include <mm/paging.h>
+
+/*
+    shared memory segments. segment i always lives at SHM_BASE + i * SHM_SEG_SIZE, in every task
+    that maps it, so the address doubles as the segment key. each segment has its own page table
+    in the directories that map it, the tables are never shared through kernel_dir
+*/
+#define SHM_BASE     0x80000000
+#define SHM_SEG_SIZE 0x400000 // one page table per segment
+#define SHM_MAX_SEGS 32
+
+typedef struct {
+    uint32_t size;
+    uint32_t *frames;
+
+    uint32_t maps; // directories mapping the segment
+    int owner; // pid of the creator
+    uint8_t used;
+    uint8_t destroyed; // freed when the last mapping goes away
+} shm_t;
+
+uint32_t shm_create(uint32_t size, pagedir_t *dir);
+uint32_t shm_map(uint32_t addr, pagedir_t *dir);
+int shm_unmap(uint32_t addr, pagedir_t *dir);
+int shm_destroy(uint32_t addr);
+int shm_owner(uint32_t addr);
+
+_Bool shm_is_mapped(uint32_t addr, pagedir_t *dir);
+void shm_release(int pid, pagedir_t *dir);
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <common.h>
+
+#define SLAB_ONSLAB_MAX (PAGE_SIZE / 8) // larger objects keep their slab descriptor off-slab
+#define SLAB_MIN_OBJS   8
+#define SLAB_END        0xFFFF
+
+typedef struct slab {
+    struct slab *next;
+    struct slab *prev;
+
+    uint32_t mem; // first object
+    uint32_t inuse;
+    uint16_t free; // index of the first free object
+
+    /*
+        followed by uint16_t bufctl[objs], the index of the next free object for every free object.
+        the free list is kept outside of the objects so they stay constructed while cached
+    */
+} slab_t;
+
+typedef struct kmem_cache {
+    char name[16];
+
+    uint32_t size; // object size (aligned)
+    uint32_t objs; // objects per slab
+    uint32_t pages; // pages per slab
+    uint32_t off; // offset of the first object in an on-slab slab
+    uint8_t offslab;
+    void (*ctor)(void *obj);
+
+    slab_t *full;
+    slab_t *partial;
+    slab_t *empty;
+
+    // statistics
+    uint32_t nslabs;
+    uint32_t active; // objects in use
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t grows;
+    uint32_t shrinks;
+
+    struct kmem_cache *next;
+} kmem_cache_t;
+
+kmem_cache_t *kmem_cache_create(char *name, uint32_t size, uint32_t align, void (*ctor)(void *obj));
+void kmem_cache_destroy(kmem_cache_t *cache);
+
+void *kmem_cache_alloc(kmem_cache_t *cache);
+void kmem_cache_free(kmem_cache_t *cache, void *obj);
+
+void kmem_cache_dump(kmem_cache_t *cache);
+void slab_dump();
\ No newline at end of file
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <common.h>
+#include <hw/ata.h>
+#include <mm/paging.h>
+
+#define SWAP_DRIVE     1      // primary slave, the whole drive is used as swap
+#define SWAP_MAX_SLOTS 0x4000 // 64 mib, slot numbers have to fit the 16 bit frame -> slot map
+#define SWAP_SECTORS   (PAGE_SIZE / ATA_SECTOR_SIZE)
+
+extern uint32_t swap_ins;
+extern uint32_t swap_outs;
+
+void init_swap();
+
+int swap_out();
+int swap_fault(uint32_t addr);
+int swap_in(page_t *page);
+
+void swap_free(page_t *page);
+void swap_forget(uint32_t frame);
+
+void swap_dump();
\ No newline at end of file
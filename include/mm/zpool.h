@@ -0,0 +1,17 @@
+#pragma once
+
+#include <common.h>
+
+#define ZPOOL_SIZE    128 // frames kept zeroed (512 kb)
+#define ZPOOL_BATCH   8   // frames zeroed per idle iteration
+#define ZPOOL_RESERVE 256 // the pool is not refilled below this many free frames
+
+extern uint32_t zpool_hits;
+extern uint32_t zpool_misses;
+
+uint32_t zpool_alloc();
+uint32_t zpool_pop();
+void zpool_refill();
+
+uint32_t zpool_count();
+void zpool_dump();
\ No newline at end of file
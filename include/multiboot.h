@@ -1,5 +1,16 @@
+#pragma once
+
 #include <common.h>
 
+#define MBOOT_FLAG_MEM  (1 << 0) // mem_lower/mem_upper are valid
+#define MBOOT_FLAG_MMAP (1 << 6) // mmap_length/mmap_addr are valid
+
+#define MBOOT_MMAP_AVAILABLE 1
+#define MBOOT_MMAP_RESERVED  2
+#define MBOOT_MMAP_ACPI      3 // acpi reclaimable
+#define MBOOT_MMAP_NVS       4
+#define MBOOT_MMAP_BADRAM    5
+
 
 struct mboot_info {
    uint32_t flags;
@@ -26,4 +37,11 @@ struct mboot_info {
    uint32_t vbe_interface_seg;
    uint32_t vbe_interface_off;
    uint32_t vbe_interface_len;
-}  __attribute__((packed));
\ No newline at end of file
+}  __attribute__((packed));
+
+struct mboot_mmap_entry {
+   uint32_t size; // size of the entry, not counting this field
+   uint64_t addr;
+   uint64_t len;
+   uint32_t type;
+} __attribute__((packed));
\ No newline at end of file
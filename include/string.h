@@ -11,6 +11,7 @@ int strncpy(char *dst, const char *src, int n);
 int strcmp(char *s, const char *s1);
 int strncmp(char *s, const char *s1, int n);
 int strlen(const char *s);
+uint32_t strlcat(char *dst, const char *src, uint32_t size);
 
 int itoa(char *dst, int n);
 int ltoa(char *dst, int64_t n);
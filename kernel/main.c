@@ -18,6 +18,7 @@
 #include <hal/acpi.h>
 #include <mm/kheap.h>
 #include <mm/paging.h>
+#include <mm/swap.h>
 #include <int/timer.h>
 #include <video/vga.h>
 #include <video/vbe.h>
@@ -124,7 +125,7 @@ void kernel_init(struct mboot_info *mboot_ptr, uint32_t initial_stack) {
     _Bool b = is_cpuid_supported();
     serial_printf("cpuid support check = %d\n", b);
 
-    init_paging();
+    init_paging(mboot);
 
     pit_install(1000);
 
@@ -150,6 +151,8 @@ void kernel_init(struct mboot_info *mboot_ptr, uint32_t initial_stack) {
     fs_size = get_drive_size(0);
     serial_printf("Device detected: id: 0, size: %u MiB\n", fs_size / 1024);
 
+    init_swap();
+
     init();
 
     // create_task((uint32_t) compositor);
@@ -2,7 +2,9 @@
 #include <assert.h>
 #include <asm/io.h>
 #include <int/task.h>
+#include <mm/buddy.h>
 #include <mm/paging.h>
+#include <mm/pcache.h>
 #include <fs/skbdfs.h>
 
 _Bool addresses[MAX_PROCESS]; // 8 mb per process
@@ -25,15 +27,13 @@ void destroy_process(struct process_address_space *s) {
     // free memory
     uint32_t base_addr = BIN_BASE_ADDR + s->address_idx * MAX_PROCESS_SIZE;
 
-    pagedir_t *dir;
-    if (getpid() == -1) {
-        dir = kernel_dir;
-    } else {
-        dir = get_task(getpid())->page_dir;
-    }
-
+    // slot tables always live in the kernel directory, tasks only link them
     for (uint32_t i = base_addr; i < base_addr + MAX_PROCESS_SIZE - 1; i += 0x1000) {
-        free_frame(get_page(i, 0, dir));
+        page_t *page = get_page(i, 0, kernel_dir);
+        if (page && page->frame) {
+            free_frame(page);
+            flush_page(i);
+        }
     }
 
     addresses[s->address_idx] = 0; // mark as free
@@ -96,12 +96,46 @@ struct process_address_space *load(char *path, _Bool has_buffer) {
     serial_printf("load: Loading binary %s at 0x%x\n", path, base_addr);
     #endif
 
-    // map memory
-    for (uint32_t j = base_addr; j < base_addr + MAX_PROCESS_SIZE - 1; j += 0x1000) {
-        alloc_frame(get_page(j, 1, kernel_dir), 0, 1);
+    // create the slot's page tables so every directory cloned from now on shares them
+    for (uint32_t addr = base_addr; addr < base_addr + MAX_PROCESS_SIZE; addr += 0x400000) {
+        if (!get_page(addr, 1, kernel_dir)) {
+            #ifdef DEBUG
+            serial_printf("load: out of page tables\n");
+            #endif
+
+            fclose(file);
+            destroy_process(s);
+            kfree(s);
+            return NULL;
+        }
     }
 
-    fread(file, file->node->size, (uint8_t *) base_addr);
+    /*
+        only the code is mapped now, heap, buffer and stack pages are faulted in by bin_fault().
+        the code pages come from the page cache and are shared copy on write by every instance
+        of the binary, so only the pages a task writes to (.data) get copied
+    */
+    for (uint32_t off = 0; off < s->binary_size; off += 0x1000) {
+        uint32_t frame = pcache_get(file->node, off / 0x1000);
+
+        if (frame == FRAME_NONE) {
+            #ifdef DEBUG
+            serial_printf("load: out of memory\n");
+            #endif
+
+            fclose(file);
+            destroy_process(s);
+            kfree(s);
+            return NULL;
+        }
+
+        page_t *page = get_page(base_addr + off, 0, kernel_dir);
+        page->present = 1;
+        page->rw = 0;
+        page->user = 1;
+        page->cow = 1;
+        page->frame = frame;
+    }
 
     fclose(file);
 
@@ -112,4 +146,36 @@ struct process_address_space *load(char *path, _Bool has_buffer) {
     s->has_buffer = 1; // set bit 0
 
     return s;
+}
+
+/*
+    demand paging for the process slots, called by pgf() for a not present page.
+    the guard page below the stack and slots that are not loaded are never backed.
+    returns 1 if the page has been mapped
+*/
+int bin_fault(uint32_t addr) {
+    if (addr < BIN_BASE_ADDR || addr >= BIN_END_ADDR) {
+        return 0;
+    }
+
+    uint32_t idx = (addr - BIN_BASE_ADDR) / MAX_PROCESS_SIZE;
+    if (!addresses[idx]) {
+        return 0;
+    }
+
+    uint32_t off = (addr - BIN_BASE_ADDR) % MAX_PROCESS_SIZE;
+    uint32_t guard = MAX_PROCESS_SIZE - PROCESS_STACK_SIZE - 0x1000;
+    if (off >= guard && off < guard + 0x1000) {
+        return 0;
+    }
+
+    // the slot tables live in kernel_dir, pgf() links them into directories that predate them
+    page_t *page = get_page(addr, 0, kernel_dir);
+    if (!page) {
+        return 0;
+    }
+
+    alloc_frame_zeroed(page, 0, 1);
+
+    return 1;
 }
\ No newline at end of file
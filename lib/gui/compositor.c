@@ -3,13 +3,16 @@
 #include <asm/io.h>
 #include <int/task.h>
 #include <int/timer.h>
+#include <mm/slab.h>
 #include <video/vbe.h>
 #include <gui/compositor.h>
 
 buffer_queue_t *queue;
+kmem_cache_t *queue_cache;
 
 void compositor_init() {
-    queue = (buffer_queue_t *) kmalloc(sizeof(buffer_queue_t));
+    queue_cache = kmem_cache_create("buffer_queue_t", sizeof(buffer_queue_t), 0, NULL);
+    queue = (buffer_queue_t *) kmem_cache_alloc(queue_cache);
 
     queue->pid = -1;
     queue->x = queue->y = 0;
@@ -33,7 +36,7 @@ void add_buffer_to_queue(uint32_t pid, uint16_t x, uint16_t y) {
     // last element is allocated with next = null
     while (temp->next != NULL) temp = temp->next;
 
-    buffer_queue_t *last = (buffer_queue_t *) kmalloc(sizeof(buffer_queue_t));
+    buffer_queue_t *last = (buffer_queue_t *) kmem_cache_alloc(queue_cache);
     last->pid = pid;
     last->x = x;
     last->y = y;
@@ -88,12 +91,12 @@ void draw_buffers() {
         }
 
         buffer_queue_t *next = queue->next;
-        kfree(queue);
+        kmem_cache_free(queue_cache, queue);
         queue = next;
     }
 
     // queue is empty
-    queue = (buffer_queue_t *) kmalloc(sizeof(buffer_queue_t));
+    queue = (buffer_queue_t *) kmem_cache_alloc(queue_cache);
     queue->pid = -1;
     queue->x = queue->y = 0;
     queue->next = NULL;
@@ -109,12 +112,16 @@ void wait_for_vsync() {
 }
 
 void compositor() {
+    // one frame every 16 ms with up to 8 ms to draw it, sleeping instead if the cpu is already reserved
+    int rt = task_set_rt(getpid(), 16, 8, 0) == 0;
+
     while (1) {
         draw_buffers();
 
-        uint32_t start = pit_get_ticks();
-        while (pit_get_ticks() < start + 16) {
-            asm volatile("hlt");
+        if (rt) {
+            task_rt_wait();
+        } else {
+            ksleep(16);
         }
     }
 }
\ No newline at end of file
@@ -78,6 +78,30 @@ int strlen(const char *s) {
     return i;
 }
 
+/*
+    appends src while dst stays null terminated inside size bytes. like the bsd strlcat it returns
+    the length it tried to create, a result >= size means src was cut off
+*/
+uint32_t strlcat(char *dst, const char *src, uint32_t size) {
+    uint32_t len = 0;
+    while (len < size && dst[len]) {
+        len++;
+    }
+    if (len == size) {
+        return len + strlen(src); // dst is not terminated inside size
+    }
+
+    uint32_t n = 0;
+    for (; src[n]; n++) {
+        if (len + n + 1 < size) {
+            dst[len + n] = src[n];
+        }
+    }
+    dst[(len + n < size) ? len + n : size - 1] = 0;
+
+    return len + n;
+}
+
 int strcmp(char *s, const char *s1) {
     int len = strlen(s);
 
@@ -0,0 +1,201 @@
+#include <assert.h>
+#include <string.h>
+
+#include <asm/io.h>
+#include <mm/buddy.h>
+#include <mm/kheap.h>
+#include <mm/swap.h>
+
+/*
+    binary buddy allocator for physical frames.
+    free blocks of order n are kept on free_head[n], threaded through the frame_map entries of
+    their first frame. bit n of order_map is set when free_head[n] is not empty, so the smallest
+    block that can satisfy a request is found with a single bsf.
+*/
+
+frame_t *frame_map;
+uint32_t nframes;
+uint32_t free_frames = 0;
+
+static uint32_t free_head[BUDDY_MAX_ORDER + 1];
+static uint32_t order_map = 0;
+
+
+static void list_add(uint32_t frame, uint32_t order) {
+    frame_t *f = &frame_map[frame];
+
+    f->order = order;
+    f->flags |= FRAME_FREE;
+    f->prev = FRAME_NONE;
+    f->next = free_head[order];
+
+    if (f->next != FRAME_NONE) {
+        frame_map[f->next].prev = frame;
+    }
+
+    free_head[order] = frame;
+    order_map |= 1 << order;
+}
+
+static void list_del(uint32_t frame, uint32_t order) {
+    frame_t *f = &frame_map[frame];
+
+    if (f->prev != FRAME_NONE) {
+        frame_map[f->prev].next = f->next;
+    } else {
+        free_head[order] = f->next;
+    }
+
+    if (f->next != FRAME_NONE) {
+        frame_map[f->next].prev = f->prev;
+    }
+
+    if (free_head[order] == FRAME_NONE) {
+        order_map &= ~(1 << order);
+    }
+
+    f->flags &= ~FRAME_FREE;
+}
+
+// every frame starts out reserved, usable memory is handed over with buddy_add_range()
+void init_buddy(uint32_t n) {
+    nframes = n;
+
+    frame_map = (frame_t *) kmalloc(nframes * sizeof(frame_t));
+    for (uint32_t i = 0; i < nframes; i++) {
+        frame_map[i].next = frame_map[i].prev = FRAME_NONE;
+        frame_map[i].order = 0;
+        frame_map[i].flags = FRAME_RESERVED;
+        frame_map[i].refs = 0;
+    }
+
+    for (int i = 0; i <= BUDDY_MAX_ORDER; i++) {
+        free_head[i] = FRAME_NONE;
+    }
+    order_map = 0;
+    free_frames = 0;
+}
+
+void buddy_add_range(uint32_t frame, uint32_t count) {
+    if (frame >= nframes) {
+        return;
+    }
+    if (frame + count > nframes) {
+        count = nframes - frame;
+    }
+
+    for (uint32_t i = frame; i < frame + count; i++) {
+        frame_map[i].flags &= ~FRAME_RESERVED;
+    }
+
+    // free the range in the largest naturally aligned blocks
+    while (count > 0) {
+        uint32_t order = 0;
+        while (order < BUDDY_MAX_ORDER && (frame & ((2 << order) - 1)) == 0 && (2u << order) <= count) {
+            order++;
+        }
+
+        buddy_free(frame, order);
+        frame += 1 << order;
+        count -= 1 << order;
+    }
+}
+
+uint32_t buddy_alloc(uint32_t order) {
+    uint32_t mask = order_map & (0xFFFFFFFF << order);
+    if (order > BUDDY_MAX_ORDER || mask == 0) {
+        return FRAME_NONE;
+    }
+
+    uint32_t o;
+    asm("bsf %1, %0" : "=r"(o) : "r"(mask));
+
+    uint32_t frame = free_head[o];
+    list_del(frame, o);
+
+    // give the upper halves back until the block has the requested size
+    while (o > order) {
+        o--;
+        list_add(frame + (1 << o), o);
+    }
+
+    for (uint32_t i = 0; i < (1u << order); i++) {
+        frame_map[frame + i].refs = 1;
+    }
+
+    free_frames -= 1 << order;
+    return frame;
+}
+
+void buddy_free(uint32_t frame, uint32_t order) {
+    // frames outside of managed memory (mmio, identity mapped kernel) are ignored
+    if (frame >= nframes || (frame_map[frame].flags & FRAME_RESERVED)) {
+        return;
+    }
+
+    assert((frame_map[frame].flags & FRAME_FREE) == 0);
+    free_frames += 1 << order;
+
+    while (order < BUDDY_MAX_ORDER) {
+        uint32_t buddy = frame ^ (1 << order);
+
+        if (buddy >= nframes || (frame_map[buddy].flags & FRAME_FREE) == 0 || frame_map[buddy].order != order) {
+            break;
+        }
+
+        list_del(buddy, order);
+        frame &= ~(1 << order);
+        order++;
+    }
+
+    list_add(frame, order);
+}
+
+/*
+    reference counting for single frames that are mapped more than once (copy on write).
+    reserved frames are not managed by the allocator and are never counted or freed
+*/
+void frame_ref(uint32_t frame) {
+    if (frame >= nframes || (frame_map[frame].flags & FRAME_RESERVED)) {
+        return;
+    }
+
+    assert(frame_map[frame].refs < 0xFFFF);
+    frame_map[frame].refs++;
+}
+
+// drops one reference and frees the frame with the last one, returns the references left
+uint32_t frame_unref(uint32_t frame) {
+    if (frame >= nframes || (frame_map[frame].flags & FRAME_RESERVED)) {
+        return 0;
+    }
+
+    if (frame_map[frame].refs > 1) {
+        return --frame_map[frame].refs;
+    }
+
+    frame_map[frame].refs = 0;
+    swap_forget(frame);
+    buddy_free(frame, 0);
+    return 0;
+}
+
+uint32_t frame_refs(uint32_t frame) {
+    if (frame >= nframes) {
+        return 0;
+    }
+
+    return frame_map[frame].refs;
+}
+
+void buddy_dump() {
+    serial_printf("buddy: %d/%d frames free\n", free_frames, nframes);
+
+    for (int i = 0; i <= BUDDY_MAX_ORDER; i++) {
+        uint32_t n = 0;
+        for (uint32_t f = free_head[i]; f != FRAME_NONE; f = frame_map[f].next) {
+            n++;
+        }
+        serial_printf("  order %d: %d blocks\n", i, n);
+    }
+}
\ No newline at end of file
@@ -1,8 +1,21 @@
 #include <assert.h>
 #include <string.h>
 
+#include <fs/skbdfs.h>
+#include <fs/vfs.h>
+#include <int/task.h>
 #include <mm/kheap.h>
 #include <mm/paging.h>
+#include <mm/pcache.h>
+#include <mm/zpool.h>
+
+#define BLOCK_OVERHEAD (sizeof(header_t) + sizeof(footer_t))
+
+#ifdef HEAP_STATS
+#define CALLER ((uint32_t) __builtin_return_address(0))
+#else
+#define CALLER 0
+#endif
 
 heap_t *kheap;
 heap_t *uheap;
@@ -11,88 +24,264 @@ extern uint32_t end;
 uint32_t placement_addr = (uint32_t) &end;
 
 
-static int find_smallest_hole(uint32_t size, uint8_t align, heap_t *heap) {
-    uint32_t iter = 0;
+static inline uint32_t bin_index(uint32_t size) {
+    return 31 - __builtin_clz(size);
+}
 
-    while (iter < heap->index.size) {
-        header_t *head = (header_t *) lookup_oarr(iter, &heap->index);
+#ifdef HEAP_STATS
+// open addressing on the return address, a full table leaves new sites unattributed
+static uint8_t site_index(uint32_t addr, heap_t *heap) {
+    heap_site_t *sites = heap->stats.sites;
+    uint32_t h = (addr >> 2) % HEAP_NSITES;
 
-        if (align > 0) {
-            uint32_t pos = (uint32_t) head;
-            int off = 0;
+    for (uint32_t i = 0; i < HEAP_NSITES; i++) {
+        uint32_t idx = (h + i) % HEAP_NSITES;
 
-            if (((pos + sizeof(header_t)) & 0xFFFFF000) != 0) {
-                off = 0x1000 - (pos + sizeof(header_t)) % 0x1000;
-            }
-            int hole_size = head->size - off;
-            if (hole_size >= size) {
-                break;
-            }
-        } else if (head->size >= size) {
-            break;
+        if (sites[idx].addr == addr) {
+            return idx;
+        }
+        if (sites[idx].addr == 0) {
+            sites[idx].addr = addr;
+            return idx;
         }
+    }
 
-        iter++;
+    return HEAP_SITE_NONE;
+}
+#endif
+
+static inline void stat_alloc(header_t *head, uint32_t site, heap_t *heap) {
+#ifdef HEAP_STATS
+    heap_stats_t *st = &heap->stats;
+    st->live++;
+    st->allocs++;
+    st->used += head->size;
+    if (st->used > st->peak) {
+        st->peak = st->used;
     }
 
-    if (iter == heap->index.size) {
-        return -1;
+    head->site = site_index(site, heap);
+    if (head->site != HEAP_SITE_NONE) {
+        st->sites[head->site].live++;
+        st->sites[head->site].bytes += head->size;
+        st->sites[head->site].calls++;
+    }
+#else
+    (void) site;
+    (void) heap;
+    head->site = HEAP_SITE_NONE;
+#endif
+}
+
+static inline void stat_free(header_t *head, heap_t *heap) {
+#ifdef HEAP_STATS
+    heap_stats_t *st = &heap->stats;
+    st->live--;
+    st->frees++;
+    st->used -= head->size;
+
+    if (head->site != HEAP_SITE_NONE) {
+        st->sites[head->site].live--;
+        st->sites[head->site].bytes -= head->size;
+    }
+#else
+    (void) head;
+    (void) heap;
+#endif
+}
+
+// the block kept its address but changed size
+static inline void stat_resize(header_t *head, uint32_t old, heap_t *heap) {
+#ifdef HEAP_STATS
+    heap_stats_t *st = &heap->stats;
+    st->used = st->used - old + head->size;
+    if (st->used > st->peak) {
+        st->peak = st->used;
+    }
+
+    if (head->site != HEAP_SITE_NONE) {
+        st->sites[head->site].bytes = st->sites[head->site].bytes - old + head->size;
+    }
+#else
+    (void) head;
+    (void) old;
+    (void) heap;
+#endif
+}
+
+static void write_footer(header_t *head) {
+    footer_t *foot = (footer_t *) ((uint32_t) head + head->size - sizeof(footer_t));
+    foot->magic = HEAP_MAGIC;
+    foot->head = head;
+}
+
+static void insert_hole(header_t *head, heap_t *heap) {
+    uint32_t i = bin_index(head->size);
+
+    head->hole = 1;
+    head->prev = NULL;
+    head->next = heap->bins[i];
+    if (head->next) {
+        head->next->prev = head;
     }
-    return iter;
+
+    heap->bins[i] = head;
+    heap->binmap |= 1 << i;
 }
 
-//header less than
-static char head_lt(void *a, void *b) {
-    return (((header_t *) a)->size < ((header_t *) b)->size) ? 1 : 0;
+// head->size has to be the same as when the hole was inserted
+static void remove_hole(header_t *head, heap_t *heap) {
+    uint32_t i = bin_index(head->size);
+
+    if (head->prev) {
+        head->prev->next = head->next;
+    } else {
+        heap->bins[i] = head->next;
+    }
+
+    if (head->next) {
+        head->next->prev = head->prev;
+    }
+
+    if (heap->bins[i] == NULL) {
+        heap->binmap &= ~(1 << i);
+    }
+
+    head->hole = 0;
+}
+
+/*
+    padding needed in front of a block so that its data is page aligned.
+    the padding is either 0 or large enough to be turned into a hole
+*/
+static uint32_t align_pad(header_t *head) {
+    uint32_t pad = (0x1000 - (((uint32_t) head + sizeof(header_t)) & 0xFFF)) & 0xFFF;
+
+    if (pad != 0 && pad < BLOCK_OVERHEAD) {
+        pad += 0x1000;
+    }
+    return pad;
 }
 
-static void expand(uint32_t size, heap_t *heap) {
+/*
+    every hole in bins[i] with i > bin_index(size - 1) is large enough, so a hole can be found
+    with a single bit scan. the head of the size's own bin is checked first so that exact size
+    reuse does not have to break up a larger hole.
+*/
+static header_t *find_hole(uint32_t size, uint8_t align, heap_t *heap) {
+    header_t *head = heap->bins[bin_index(size)];
+    if (head != NULL && head->size >= size + ((align) ? align_pad(head) : 0)) {
+        return head;
+    }
+
+    // worst case padding for page aligned blocks
+    if (align) {
+        size += 0x1000 + BLOCK_OVERHEAD;
+    }
+
+    uint32_t i = bin_index(size - 1) + 1;
+    if (i >= HEAP_NBINS) {
+        return NULL;
+    }
+
+    uint32_t mask = heap->binmap & (0xFFFFFFFF << i);
+    if (mask == 0) {
+        return NULL;
+    }
+
+    return heap->bins[__builtin_ctz(mask)];
+}
+
+// returns nonzero when the frames could not be mapped, the heap is left as it was
+static int expand(uint32_t size, heap_t *heap) {
     assert(size > heap->end - heap->start);
 
-    if ((size & 0xFFFFF000) != 0) {
+    if ((size & 0xFFF) != 0) {
         size &= 0xFFFFF000;
         size += 0x1000;
     }
     assert(heap->start + size <= heap->max);
 
     uint32_t old = heap->end - heap->start;
-    uint32_t i = old;
-    while (i < size) {
-        alloc_frame(get_page(heap->start + i, 1, kernel_dir), (heap->supervisor) ? 1 : 0, (heap->ro) ? 0 : 1);
-        i += 0x1000;
+    if (map_frames(heap->start + old, size - old, (heap->supervisor) ? 1 : 0, (heap->ro) ? 0 : 1, kernel_dir) != 0) {
+        return -1;
     }
 
     heap->end = heap->start + size;
+
+#ifdef HEAP_STATS
+    heap->stats.expands++;
+#endif
+    return 0;
 }
 
 static uint32_t contract(uint32_t size, heap_t *heap) {
-    assert(size < heap->end - heap->start);
-
-    if (size & 0x1000) {
-        size &= 0x1000;
+    if ((size & 0xFFF) != 0) {
+        size &= 0xFFFFF000;
         size += 0x1000;
     }
 
-    if (size < HEAP_MIN_SZ) {
-        size = HEAP_MIN_SZ;
+    if (size < heap->min) {
+        size = heap->min;
     }
+
     uint32_t old = heap->end - heap->start;
-    uint32_t i = old - 0x1000;
-    while (size < i) {
+    if (size >= old) {
+        return old;
+    }
+
+    for (uint32_t i = size; i < old; i += 0x1000) {
         free_frame(get_page(heap->start + i, 0, kernel_dir));
-        i -= 0x1000;
+        flush_page(heap->start + i);
     }
 
     heap->end = heap->start + size;
+
+#ifdef HEAP_STATS
+    heap->stats.contracts++;
+#endif
     return size;
 }
 
-uint32_t kmalloc_int(uint32_t sz, int align, uint32_t *phy) {
+// grows the heap so that it can hold a block of the given size, returns the (last) hole that will hold it or NULL
+static header_t *grow(uint32_t size, uint8_t align, heap_t *heap) {
+    uint32_t old_end = heap->end;
+
+    if (align) {
+        size += 0x1000 + BLOCK_OVERHEAD;
+    }
+    if (expand(heap->end - heap->start + size, heap) != 0) {
+        return NULL;
+    }
+
+    header_t *head;
+    footer_t *last = (footer_t *) (old_end - sizeof(footer_t));
+
+    if (old_end > heap->start && last->magic == HEAP_MAGIC && last->head->hole == 1) {
+        // the last block is a hole, extend it
+        head = last->head;
+        remove_hole(head, heap);
+        head->size += heap->end - old_end;
+    } else {
+        head = (header_t *) old_end;
+        head->magic = HEAP_MAGIC;
+        head->size = heap->end - old_end;
+    }
+
+    write_footer(head);
+    insert_hole(head, heap);
+
+    return head;
+}
+
+static void *alloc_block(uint32_t size, uint8_t align, heap_t *heap, uint32_t site);
+static void *realloc_block(void *p, uint32_t size, uint8_t align, heap_t *heap, uint32_t site);
+
+static uint32_t kmalloc_site(uint32_t sz, int align, uint32_t *phy, uint32_t site) {
     if (kheap != 0) {
-        void *addr = alloc(sz, (uint8_t) align, kheap);
-        if (phy != 0) {
-            page_t *page = get_page((uint32_t) addr, 0, kernel_dir);
-            *phy = page->frame * 0x1000 + ((uint32_t) addr & 0xFFF);
+        void *addr = alloc_block(sz, (uint8_t) align, kheap, site);
+        if (phy != 0 && addr != NULL) {
+            *phy = get_phys((uint32_t) addr, kernel_dir);
         }
         return (uint32_t) addr;
     } else {
@@ -109,24 +298,29 @@ uint32_t kmalloc_int(uint32_t sz, int align, uint32_t *phy) {
     }
 }
 
+// the wrappers pass their own return address so that allocations are attributed to the caller
+uint32_t kmalloc_int(uint32_t sz, int align, uint32_t *phy) {
+    return kmalloc_site(sz, align, phy, CALLER);
+}
+
 uint32_t kmalloc_a(uint32_t sz) {
-    return kmalloc_int(sz, 1, 0);
+    return kmalloc_site(sz, 1, 0, CALLER);
 }
 
 uint32_t kmalloc_p(uint32_t sz, uint32_t *phy) {
-    return kmalloc_int(sz, 0, phy);
+    return kmalloc_site(sz, 0, phy, CALLER);
 }
 
 uint32_t kmalloc_ap(uint32_t sz, uint32_t *phy) {
-    return kmalloc_int(sz, 1, phy);
+    return kmalloc_site(sz, 1, phy, CALLER);
 }
 
 uint32_t kmalloc(uint32_t sz) {
-    return kmalloc_int(sz, 0, 0);
+    return kmalloc_site(sz, 0, 0, CALLER);
 }
 
 void *kcalloc(uint32_t nmemb, uint32_t sz) {
-    void *ptr = (void *) kmalloc(nmemb * sz);
+    void *ptr = (void *) kmalloc_site(nmemb * sz, 0, 0, CALLER);
     if (ptr == 0) {
         return ptr;
     }
@@ -141,128 +335,136 @@ heap_t *mkheap(uint32_t start, uint32_t end, uint32_t max, uint8_t supervisor, u
     assert(start % 0x1000 == 0);
     assert(end % 0x1000 == 0);
 
-    heap->index = place_oarr((void *) start, HEAP_INDEX_SZ, &head_lt);
-    start += sizeof(type_t) * HEAP_INDEX_SZ;
-
-    if ((start & 0xFFFFF000) != 0) {
-        start &= 0xFFFFF000;
-        start += 0x1000;
-    }
+    memset(heap->bins, 0, sizeof(heap->bins));
+    heap->binmap = 0;
 
     heap->start      = start;
     heap->end        = end;
     heap->max        = max;
+    heap->min        = (end - start < HEAP_MIN_SZ) ? end - start : HEAP_MIN_SZ;
     heap->supervisor = supervisor;
     heap->ro         = ro;
 
+#ifdef HEAP_STATS
+    memset(&heap->stats, 0, sizeof(heap_stats_t));
+#endif
+
     header_t *hole = (header_t *) start;
-    hole->size = end - start;
     hole->magic = HEAP_MAGIC;
-    hole->hole = 1;
-    ins_oarr((void *) hole, &heap->index);
+    hole->size = end - start;
+    write_footer(hole);
+    insert_hole(hole, heap);
 
     return heap;
 }
 
 
-void *alloc(uint32_t size, uint8_t align, heap_t *heap) {
-    uint32_t new_size = size + sizeof(header_t) + sizeof(footer_t);
-    int iter = find_smallest_hole(new_size, align, heap);
+static void *alloc_block(uint32_t size, uint8_t align, heap_t *heap, uint32_t site) {
+    size = (size + 3) & ~3; // keep blocks 4 byte aligned
+    uint32_t new_size = size + BLOCK_OVERHEAD;
 
-    if (iter == -1) {
-        uint32_t old = heap->end - heap->start;
-        uint32_t old_end = heap->end;
+    header_t *head = find_hole(new_size, align, heap);
+    if (head == NULL) {
+        head = grow(new_size, align, heap);
+        if (head == NULL) {
+            return NULL;
+        }
+    }
 
-        expand(old + new_size, heap);
-        uint32_t new = heap->end - heap->start;
+    remove_hole(head, heap);
 
-        iter = 0;
-        uint32_t idx = -1;
-        uint32_t val = 0x0;
+    if (align) {
+        uint32_t pad = align_pad(head);
 
-        while (iter < heap->index.size) {
-            uint32_t tmp = (uint32_t) lookup_oarr(iter, &heap->index);
-            if (tmp > val) {
-                val = tmp;
-                idx = iter;
-            }
-            iter++;
-        }
+        // the padding stays a hole instead of being thrown away
+        if (pad != 0) {
+            header_t *blk = (header_t *) ((uint32_t) head + pad);
+            blk->size = head->size - pad;
 
-        if (idx == -1) {
-            header_t *head = (header_t *) old_end;
-            head->magic = HEAP_MAGIC;
-            head->size = new - old;
-            head->hole = 1;
-            
-            footer_t *foot = (footer_t *) (old_end + head->size - sizeof(footer_t));
-            foot->magic = HEAP_MAGIC;
-            foot->head = head;
-
-            ins_oarr((void *) head, &heap->index);
-        } else {
-            header_t *head = lookup_oarr(idx, &heap->index);
-            head->size = new - old;
-
-            footer_t *foot = (footer_t *) ((uint32_t) head + head->size - sizeof(footer_t));
-            foot->magic = HEAP_MAGIC;
-            foot->head = head;
-        }
+            head->size = pad;
+            write_footer(head);
+            insert_hole(head, heap);
 
-        return alloc(size, align, heap);
+            head = blk;
+        }
     }
 
-    header_t *orig_head = (header_t *) lookup_oarr(iter, &heap->index);
-    uint32_t orig_pos = (uint32_t) orig_head;
-    uint32_t orig_sz = orig_head->size;
+    // split off the rest if it can hold a hole
+    if (head->size - new_size >= BLOCK_OVERHEAD) {
+        header_t *rest = (header_t *) ((uint32_t) head + new_size);
+        rest->magic = HEAP_MAGIC;
+        rest->size = head->size - new_size;
+        write_footer(rest);
+        insert_hole(rest, heap);
 
-    if (orig_sz - new_size < sizeof(header_t) + sizeof(footer_t)) {
-        size += orig_sz - new_size;
-        new_size = orig_sz;
+        head->size = new_size;
     }
 
-    if (align && orig_pos & 0xFFFFF000) {
-        uint32_t new_pos = orig_pos + 0x1000 - (orig_pos & 0xFFF) - sizeof(header_t);
-        
-        header_t *head = (header_t *) orig_pos;
-        head->size = 0x1000;
-        head->magic = HEAP_MAGIC;
-        head->hole = 1;
+    head->magic = HEAP_MAGIC;
+    head->hole = 0;
+    write_footer(head);
+    stat_alloc(head, site, heap);
 
-        footer_t *foot = (footer_t *) ((uint32_t) new_pos - sizeof(footer_t));
-        foot->magic = HEAP_MAGIC;
-        foot->head = head;
-        orig_pos = new_pos;
-        orig_sz -= head->size;
-    } else {
-        rm_oarr(iter, &heap->index);
+    return (void *) ((uint32_t) head + sizeof(header_t));
+}
+
+void *alloc(uint32_t size, uint8_t align, heap_t *heap) {
+    return alloc_block(size, align, heap, CALLER);
+}
+
+// turns an allocated block back into a hole, merging it with its neighbours
+static void free_block(header_t *head, heap_t *heap) {
+    // coalesce with the previous block
+    if ((uint32_t) head > heap->start) {
+        footer_t *testf = (footer_t *) ((uint32_t) head - sizeof(footer_t));
+        if (testf->magic == HEAP_MAGIC && testf->head->hole == 1) {
+            header_t *prev = testf->head;
+            remove_hole(prev, heap);
+
+            prev->size += head->size;
+            head = prev;
+        }
     }
 
-    header_t *blk = (header_t *) orig_pos;
-    blk->magic = HEAP_MAGIC;
-    blk->hole = 0;
-    blk->size = new_size;
+    // coalesce with the next block
+    header_t *testh = (header_t *) ((uint32_t) head + head->size);
+    if ((uint32_t) testh < heap->end && testh->magic == HEAP_MAGIC && testh->hole == 1) {
+        remove_hole(testh, heap);
+        head->size += testh->size;
+    }
 
-    footer_t *blk_footer = (footer_t *) (orig_pos + sizeof(header_t) + size);
-    blk_footer->magic = HEAP_MAGIC;
-    blk_footer->head = blk;
+    write_footer(head);
 
-    if (orig_sz - new_size > 0) {
-        header_t *head = (header_t *) (orig_pos + sizeof(header_t) + size + sizeof(footer_t));
-        head->magic = HEAP_MAGIC;
-        head->hole = 1;
-        head->size = orig_sz - new_size;
+    // give the end of the heap back
+    if ((uint32_t) head + head->size == heap->end) {
+        uint32_t new = contract((uint32_t) head - heap->start + BLOCK_OVERHEAD, heap);
 
-        footer_t *foot = (footer_t *) ((uint32_t) head + orig_sz - new_size - sizeof(footer_t));
-        if ((uint32_t) foot < heap->end) {
-            foot->magic = HEAP_MAGIC;
-            foot->head = head;
-        }
+        head->size = heap->start + new - (uint32_t) head;
+        write_footer(head);
+    }
+
+    insert_hole(head, heap);
+}
+
+/*
+    checks that p is an allocated block of heap before a pointer that came from a user task is
+    freed or resized. the headers of a user heap are writable by the task, so everything is range
+    checked before it is followed
+*/
+int heap_is_block(void *p, heap_t *heap) {
+    uint32_t addr = (uint32_t) p;
+    if (addr < heap->start + sizeof(header_t) || addr >= heap->end) {
+        return 0;
+    }
 
-        ins_oarr((void *) head, &heap->index);
+    header_t *head = (header_t *) (addr - sizeof(header_t));
+    if (head->magic != HEAP_MAGIC || head->hole || head->size < BLOCK_OVERHEAD ||
+        head->size > heap->end - (uint32_t) head) {
+        return 0;
     }
 
-    return (void *) ((uint32_t) blk + sizeof(header_t));
+    footer_t *foot = (footer_t *) ((uint32_t) head + head->size - sizeof(footer_t));
+    return foot->magic == HEAP_MAGIC && foot->head == head;
 }
 
 void free(void *p, heap_t *heap) {
@@ -270,65 +472,247 @@ void free(void *p, heap_t *heap) {
         return;
     }
 
-    header_t *head = (header_t *) ((uint32_t)p - sizeof(header_t));
-    footer_t *foot = (footer_t *) ((uint32_t)head + head->size - sizeof(footer_t));
+    header_t *head = (header_t *) ((uint32_t) p - sizeof(header_t));
+    footer_t *foot = (footer_t *) ((uint32_t) head + head->size - sizeof(footer_t));
 
     assert(head->magic == HEAP_MAGIC);
     assert(foot->magic == HEAP_MAGIC);
 
-    head->hole = 1;
-    char do_add = 1;
+    stat_free(head, heap);
+    free_block(head, heap);
+}
 
-    footer_t *testf = (footer_t *) ((uint32_t) head - sizeof(footer_t));
-    if (testf->magic == HEAP_MAGIC && testf->head->hole == 1) {
-        uint32_t cache = head->size;
-        head = testf->head;
-        foot->head = head;
-        head->size += cache;
-        do_add = 0;
+void kfree(void *p) {
+    free(p, kheap);
+}
+
+// cuts an allocated block down to size, the rest is freed so that it merges with a following hole
+static void split_block(header_t *head, uint32_t size, heap_t *heap) {
+    if (head->size - size < BLOCK_OVERHEAD) {
+        return;
     }
 
-    header_t *testh = (header_t *) ((uint32_t) foot + sizeof(footer_t));
-    if (testh->magic == HEAP_MAGIC && testh->hole == 1) {
-        head->size += testh->size;
-        testf = (footer_t *) ((uint32_t) testh + testh->size - sizeof(footer_t));
+    header_t *rest = (header_t *) ((uint32_t) head + size);
+    rest->magic = HEAP_MAGIC;
+    rest->hole = 0;
+    rest->size = head->size - size;
+    write_footer(rest);
+
+    head->size = size;
+    write_footer(head);
+
+    free_block(rest, heap);
+}
+
+/*
+    resizes a block in place when possible: shrinking splits the block, growing takes the hole that
+    follows it, or expands the heap when the block is the last one. only otherwise the data is moved.
+    an aligned block stays aligned, in place or not
+*/
+static void *realloc_block(void *p, uint32_t size, uint8_t align, heap_t *heap, uint32_t site) {
+    if (p == 0) {
+        return alloc_block(size, align, heap, site);
+    }
+
+    if (size == 0) {
+        free(p, heap);
+        return 0;
+    }
+
+    header_t *head = (header_t *) ((uint32_t) p - sizeof(header_t));
+    assert(head->magic == HEAP_MAGIC && head->hole == 0);
+
+    size = (size + 3) & ~3;
+    uint32_t new_size = size + BLOCK_OVERHEAD;
+
+    uint32_t old = head->size;
+
+    if (new_size <= head->size) {
+        split_block(head, new_size, heap);
+        stat_resize(head, old, heap);
+        return p;
+    }
+
+    header_t *next = (header_t *) ((uint32_t) head + head->size);
+    _Bool next_hole = (uint32_t) next < heap->end && next->magic == HEAP_MAGIC && next->hole == 1;
 
-        foot = testf;
-        uint32_t iter = 0;
-        while ((iter < heap->index.size) && (lookup_oarr(iter, &heap->index) != (void *) testh)) {
-            iter++;
+    uint32_t avail = head->size + ((next_hole) ? next->size : 0);
+    _Bool last = (uint32_t) head + avail == heap->end;
+    uint32_t new_end = ((uint32_t) head + new_size + 0xFFF) & 0xFFFFF000;
+
+    uint32_t old_end = heap->end;
+    if (avail >= new_size || (last && new_end <= heap->max && expand(new_end - heap->start, heap) == 0)) {
+        if (next_hole) {
+            remove_hole(next, heap);
         }
+        head->size = avail + (heap->end - old_end);
 
-        assert(iter < heap->index.size);
-        rm_oarr(iter, &heap->index);
+        write_footer(head);
+        split_block(head, new_size, heap);
+        stat_resize(head, old, heap);
+        return p;
     }
 
-    if ((uint32_t) foot + sizeof(footer_t) == heap->end) {
-        uint32_t old = heap->end - heap->start;
-        uint32_t new = contract((uint32_t) head - heap->start, heap);
+    void *n = alloc_block(size, align, heap, site);
+    if (n == NULL) {
+        return NULL; // p is still valid
+    }
+    memcpy(n, p, head->size - BLOCK_OVERHEAD);
+    free(p, heap);
 
-        if (head->size - (old - new) > 0) {
-            head->size -= old - new;
-            foot = (footer_t *) ((uint32_t) head + head->size - sizeof(footer_t));
-            foot->magic = HEAP_MAGIC;
-            foot->head = head;
-        } else {
-            uint32_t iter = 0;
-            while ((iter < heap->index.size) && (lookup_oarr(iter, &heap->index) != (void *) testh)) {
-                iter++;
-            }
+    return n;
+}
+
+void *realloc(void *p, uint32_t size, uint8_t align, heap_t *heap) {
+    return realloc_block(p, size, align, heap, CALLER);
+}
 
-            if (iter < heap->index.size) {
-                rm_oarr(iter, &heap->index);    
+void *krealloc(void *p, uint32_t sz) {
+    return realloc_block(p, sz, 0, kheap, CALLER);
+}
+
+// hole count, free bytes and the largest hole, taken from the free lists
+static void hole_stats(heap_t *heap, uint32_t *holes, uint32_t *free_bytes, uint32_t *largest) {
+    *holes = *free_bytes = *largest = 0;
+
+    for (int i = 0; i < HEAP_NBINS; i++) {
+        for (header_t *h = heap->bins[i]; h != NULL; h = h->next) {
+            (*holes)++;
+            *free_bytes += h->size;
+            if (h->size > *largest) {
+                *largest = h->size;
             }
         }
     }
+}
+
+// bytes of the heap in blocks and in holes, headers are counted as used
+void heap_usage(heap_t *heap, uint32_t *used, uint32_t *free_bytes) {
+    uint32_t holes, largest;
+    hole_stats(heap, &holes, free_bytes, &largest);
 
-    if (do_add == 1) {
-        ins_oarr((void *) head, &heap->index);
+    *used = heap->end - heap->start - *free_bytes;
+}
+
+// share of the free bytes that can't be handed out as one block, in percent
+static uint32_t fragmentation(uint32_t free_bytes, uint32_t largest) {
+    return (free_bytes == 0) ? 0 : 100 - largest / ((free_bytes + 99) / 100);
+}
+
+void heap_dump(heap_t *heap) {
+    uint32_t holes, free_bytes, largest;
+    hole_stats(heap, &holes, &free_bytes, &largest);
+
+    serial_printf("heap 0x%x - 0x%x: %u holes, %u bytes free, largest %u, fragmentation %u%%\n",
+        heap->start, heap->end, holes, free_bytes, largest, fragmentation(free_bytes, largest));
+
+#ifdef HEAP_STATS
+    heap_stats_t *st = &heap->stats;
+    serial_printf("  %u live blocks, %u bytes used (peak %u), %u allocs, %u frees, %u expands, %u contracts\n",
+        st->live, st->used, st->peak, st->allocs, st->frees, st->expands, st->contracts);
+
+    for (int i = 0; i < HEAP_NSITES; i++) {
+        heap_site_t *s = &st->sites[i];
+        if (s->addr != 0 && s->live != 0) {
+            serial_printf("  0x%x: %u live, %u bytes, %u calls\n", s->addr, s->live, s->bytes, s->calls);
+        }
     }
+#endif
 }
 
-void kfree(void *p) {
-    free(p, kheap);
+static void put_num(char *buf, uint32_t cap, const char *label, uint32_t v) {
+    char num[12];
+    uitoa(num, v);
+
+    strlcat(buf, label, cap);
+    strlcat(buf, num, cap);
+    strlcat(buf, "\n", cap);
+}
+
+static void format_heap(char *buf, uint32_t cap, const char *name, heap_t *heap) {
+    uint32_t holes, free_bytes, largest;
+    hole_stats(heap, &holes, &free_bytes, &largest);
+
+    strlcat(buf, name, cap);
+    put_num(buf, cap, "size: ", heap->end - heap->start);
+    put_num(buf, cap, "holes: ", holes);
+    put_num(buf, cap, "free: ", free_bytes);
+    put_num(buf, cap, "largest hole: ", largest);
+    put_num(buf, cap, "fragmentation: ", fragmentation(free_bytes, largest));
+
+#ifdef HEAP_STATS
+    heap_stats_t *st = &heap->stats;
+    put_num(buf, cap, "live: ", st->live);
+    put_num(buf, cap, "used: ", st->used);
+    put_num(buf, cap, "peak: ", st->peak);
+    put_num(buf, cap, "allocs: ", st->allocs);
+    put_num(buf, cap, "frees: ", st->frees);
+    put_num(buf, cap, "expands: ", st->expands);
+    put_num(buf, cap, "contracts: ", st->contracts);
+
+    for (int i = 0; i < HEAP_NSITES; i++) {
+        heap_site_t *s = &st->sites[i];
+        if (s->addr == 0 || s->live == 0) {
+            continue;
+        }
+
+        char addr[12];
+        int2hex(addr, s->addr);
+        strlcat(buf, "site 0x", cap);
+        strlcat(buf, addr, cap);
+        strlcat(buf, "\n", cap);
+        put_num(buf, cap, "  live: ", s->live);
+        put_num(buf, cap, "  bytes: ", s->bytes);
+        put_num(buf, cap, "  calls: ", s->calls);
+    }
+#endif
+}
+
+// the frame pools the heaps draw from
+static void format_pools(char *buf, uint32_t cap) {
+    strlcat(buf, "[zpool]\n", cap);
+    put_num(buf, cap, "frames: ", zpool_count());
+    put_num(buf, cap, "hits: ", zpool_hits);
+    put_num(buf, cap, "misses: ", zpool_misses);
+
+    strlcat(buf, "[pcache]\n", cap);
+    put_num(buf, cap, "pages: ", pcache_pages);
+    put_num(buf, cap, "hits: ", pcache_hits);
+    put_num(buf, cap, "misses: ", pcache_misses);
+}
+
+/*
+    /dev/kheap: a text report of the kernel heap, the heap of the reading task and the zeroed pool
+    and page cache counters. the report is rebuilt on every read and served from file->ptr_local
+*/
+uint32_t heap_stats_read(file_t *file, uint32_t size, uint8_t *buffer) {
+    static char report[0x2000];
+    report[0] = 0;
+    format_heap(report, sizeof(report), "[kheap]\n", kheap);
+
+    tcb_t *task = get_task(getpid());
+    if (task != NULL && task->heap != NULL) {
+        format_heap(report, sizeof(report), "[task heap]\n", task->heap);
+    }
+    format_pools(report, sizeof(report));
+
+    return vfs_read_text(file, report, size, buffer);
+}
+
+// any write to /dev/kheap dumps the same report to the serial port
+uint32_t heap_stats_write(file_t *file, uint32_t size, uint8_t *buffer) {
+    (void) file;
+    (void) buffer;
+
+    heap_dump(kheap);
+
+    tcb_t *task = get_task(getpid());
+    if (task != NULL && task->heap != NULL) {
+        heap_dump(task->heap);
+    }
+
+    zpool_dump();
+    pcache_dump();
+
+    return size;
 }
\ No newline at end of file
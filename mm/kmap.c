@@ -0,0 +1,131 @@
+#include <assert.h>
+#include <intrin.h>
+
+#include <mm/kmap.h>
+#include <mm/paging.h>
+
+/*
+    the window has one page per slot. a slot is only valid until it is mapped again, callers
+    keep interrupts off while they use it so that an interrupt handler can't remap it underneath.
+    with sse2 the copies use non temporal stores (movnti), they only need general purpose
+    registers so no fpu/sse state has to be saved
+*/
+
+extern _Bool cpuid_support;
+
+static page_t *window;
+static _Bool sse2 = 0;
+
+
+// has to run before the identity map is built, the window's page table comes from the placement allocator
+void init_kmap() {
+    window = get_page(KMAP_BASE, 1, kernel_dir);
+
+    if (cpuid_support) {
+        uint32_t eax, ebx, ecx, edx;
+        __cpuid(1, &eax, &ebx, &ecx, &edx);
+        sse2 = (edx & (1 << 26)) != 0;
+    }
+}
+
+void *kmap(uint32_t frame, int slot) {
+    assert(slot < KMAP_SLOTS);
+
+    uint32_t vaddr = KMAP_BASE + slot * 0x1000;
+
+    window[slot].present = 1;
+    window[slot].rw = 1;
+    window[slot].user = 0;
+    window[slot].frame = frame;
+    flush_page(vaddr);
+
+    return (void *) vaddr;
+}
+
+void kunmap(int slot) {
+    assert(slot < KMAP_SLOTS);
+
+    window[slot].present = 0;
+    window[slot].frame = 0;
+    flush_page(KMAP_BASE + slot * 0x1000);
+}
+
+static void copy_nt(void *dst, void *src) {
+    uint32_t n = 0x1000 / 16;
+
+    asm volatile(
+        "1:\n"
+        "mov (%1), %%eax\n"
+        "mov 4(%1), %%edx\n"
+        "movnti %%eax, (%0)\n"
+        "movnti %%edx, 4(%0)\n"
+        "mov 8(%1), %%eax\n"
+        "mov 12(%1), %%edx\n"
+        "movnti %%eax, 8(%0)\n"
+        "movnti %%edx, 12(%0)\n"
+        "add $16, %0\n"
+        "add $16, %1\n"
+        "dec %2\n"
+        "jnz 1b\n"
+        "sfence"
+        : "+r"(dst), "+r"(src), "+r"(n)
+        :: "eax", "edx", "memory"
+    );
+}
+
+static void zero_nt(void *dst) {
+    uint32_t n = 0x1000 / 16;
+
+    asm volatile(
+        "xor %%eax, %%eax\n"
+        "1:\n"
+        "movnti %%eax, (%0)\n"
+        "movnti %%eax, 4(%0)\n"
+        "movnti %%eax, 8(%0)\n"
+        "movnti %%eax, 12(%0)\n"
+        "add $16, %0\n"
+        "dec %1\n"
+        "jnz 1b\n"
+        "sfence"
+        : "+r"(dst), "+r"(n)
+        :: "eax", "memory"
+    );
+}
+
+void copy_frame(uint32_t dst, uint32_t src) {
+    uint32_t eflags;
+    asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+
+    void *d = kmap(dst, KMAP_DST);
+    void *s = kmap(src, KMAP_SRC);
+
+    if (sse2) {
+        copy_nt(d, s);
+    } else {
+        uint32_t n = 0x1000 / 4;
+        asm volatile("rep movsl" : "+D"(d), "+S"(s), "+c"(n) :: "memory");
+    }
+
+    kunmap(KMAP_SRC);
+    kunmap(KMAP_DST);
+
+    asm volatile("push %0; popf" :: "r"(eflags) : "memory", "cc");
+}
+
+void zero_frame(uint32_t frame) {
+    uint32_t eflags;
+    asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+
+    void *d = kmap(frame, KMAP_DST);
+
+    if (sse2) {
+        zero_nt(d);
+    } else {
+        uint32_t n = 0x1000 / 4;
+        asm volatile("rep stosl" : "+D"(d), "+c"(n) : "a"(0) : "memory");
+    }
+
+    kunmap(KMAP_DST);
+
+    asm volatile("push %0; popf" :: "r"(eflags) : "memory", "cc");
+}
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include <errno.h>
+#include <string.h>
+
+#include <asm/io.h>
+#include <int/task.h>
+#include <mm/buddy.h>
+#include <mm/kheap.h>
+#include <mm/mmap.h>
+#include <mm/pcache.h>
+#include <mm/slab.h>
+
+/*
+    file mappings are populated on fault from the page cache, so every task mapping the same page
+    of a file shares one frame. the pages are read only, a write kills the task like any other
+    protection fault
+*/
+
+static vma_t *find_vma(vma_t *maps, uint32_t addr) {
+    for (vma_t *v = maps; v; v = v->next) {
+        if (addr >= v->start && addr < v->end) {
+            return v;
+        }
+    }
+
+    return NULL;
+}
+
+static void unmap_vma(vma_t *v, pagedir_t *dir) {
+    for (uint32_t addr = v->start; addr < v->end; addr += 0x1000) {
+        if (!dir->tables[addr / 0x400000]) {
+            addr |= 0x3FF000; // no table, skip to the next one
+            continue;
+        }
+
+        page_t *page = get_page(addr, 0, dir);
+        if (page->frame) {
+            frame_unref(page->frame);
+            *(uint32_t *) page = 0;
+
+            if (dir == crt_dir) {
+                flush_page(addr);
+            }
+        }
+    }
+
+    kmem_cache_free(node_cache, v->node);
+    kfree(v);
+}
+
+// maps size bytes of the file at path, starting at offset, returns the address or 0
+uint32_t mmap_file(tcb_t *task, char *path, uint32_t offset, uint32_t size) {
+    if (size == 0 || offset % PAGE_SIZE != 0) {
+        return 0;
+    }
+
+    file_t *file = fopen(path, FMODE_R);
+    if (!file) {
+        return 0;
+    }
+
+    if (offset >= file->node->size) {
+        fclose(file);
+        return 0;
+    }
+
+    size = (size + 0xFFF) & 0xFFFFF000;
+
+    // first fit between the existing mappings
+    uint32_t start = MMAP_BASE;
+    vma_t **link = &task->maps;
+    while (*link && (*link)->start < start + size) {
+        start = (*link)->end;
+        link = &(*link)->next;
+    }
+
+    if (start + size > MMAP_END || start + size < start) {
+        fclose(file);
+        return 0;
+    }
+
+    vma_t *v = (vma_t *) kmalloc(sizeof(vma_t));
+    v->start = start;
+    v->end = start + size;
+    v->offset = offset;
+
+    // the node outlives the file_t
+    v->node = (node_t *) kmem_cache_alloc(node_cache);
+    memcpy(v->node, file->node, sizeof(node_t));
+    fclose(file);
+
+    v->next = *link;
+    *link = v;
+
+    return start;
+}
+
+int munmap_file(tcb_t *task, uint32_t addr) {
+    for (vma_t **link = &task->maps; *link; link = &(*link)->next) {
+        vma_t *v = *link;
+
+        if (v->start == addr) {
+            *link = v->next;
+            unmap_vma(v, task->page_dir);
+            return 0;
+        }
+    }
+
+    return EINVAL;
+}
+
+// called by pgf() for a not present page, returns 1 if the page has been mapped
+int mmap_fault(uint32_t addr) {
+    if (addr < MMAP_BASE || addr >= MMAP_END || getpid() == -1) {
+        return 0;
+    }
+
+    tcb_t *task = get_task(getpid());
+    vma_t *v = find_vma(task->maps, addr);
+    if (!v) {
+        return 0;
+    }
+
+    uint32_t index = (v->offset + (addr - v->start)) / PAGE_SIZE;
+    if (index * PAGE_SIZE >= v->node->size) {
+        return 0; // past the end of the file
+    }
+
+    page_t *page = get_page(addr, 1, crt_dir);
+    if (!page) {
+        return 0; // no page table, the task gets SIGSEGV
+    }
+
+    uint32_t frame = pcache_get(v->node, index);
+    if (frame == FRAME_NONE) {
+        return 0;
+    }
+
+    page->present = 1;
+    page->rw = 0;
+    page->user = 1;
+    page->frame = frame;
+
+    return 1;
+}
+
+// task exit: drops every mapping and the page tables of the region
+void mmap_release(tcb_t *task) {
+    pagedir_t *dir = task->page_dir;
+
+    while (task->maps) {
+        vma_t *v = task->maps;
+        task->maps = v->next;
+        unmap_vma(v, dir);
+    }
+
+    for (uint32_t i = MMAP_BASE / 0x400000; i < MMAP_END / 0x400000; i++) {
+        if (dir->tables[i]) {
+            free_table(dir->tables[i]);
+            dir->tables[i] = NULL;
+            dir->tab_phy[i] = 0;
+        }
+    }
+}
\ No newline at end of file
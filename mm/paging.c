@@ -1,87 +1,178 @@
 #include <assert.h>
+#include <errno.h>
 #include <string.h>
 
+#include <bin.h>
+#include <intrin.h>
 #include <asm/io.h>
+#include <int/task.h>
+#include <mm/buddy.h>
 #include <mm/kheap.h>
+#include <mm/kmap.h>
+#include <mm/mmap.h>
 #include <mm/paging.h>
+#include <mm/pcache.h>
+#include <mm/swap.h>
+#include <mm/zpool.h>
 #include <video/vbe.h>
 #include <video/vga.h>
 
-#define INDEX_FROM_BIT(a) (a / 32)
-#define OFF_FROM_BIT(a) (a % 32)
-
-extern void copy_page_physical(uint32_t, uint32_t);
 extern heap_t *kheap;
+extern _Bool cpuid_support;
 
 pagedir_t *kernel_dir = 0;
 pagedir_t *crt_dir = 0;
 
-uint32_t *frames;
-uint32_t nframes;
-
 extern uint32_t placement_addr;
 
-static void set_frame(uint32_t frame) {
-    uint32_t idx = INDEX_FROM_BIT(frame);
-    uint32_t off = OFF_FROM_BIT(frame);
-    frames[idx] |= (0x1 << off);
-}
+static _Bool pse = 0;
+static _Bool pge = 0;
 
-static void clear_frame(uint32_t addr) {
-    uint32_t frame = addr / 0x1000;
-    uint32_t idx = INDEX_FROM_BIT(frame);
-    uint32_t off = OFF_FROM_BIT(frame);
-    frames[idx] &= ~(0x1 << off);
-}
+static pagedir_t *dir_pool[DIR_POOL_SIZE];
+static uint32_t ndir_pool = 0;
 
-static uint32_t test_frame(uint32_t addr) {
-    uint32_t frame = addr / 0x1000;
-    uint32_t idx = INDEX_FROM_BIT(frame);
-    uint32_t off = OFF_FROM_BIT(frame);
-    return (frames[idx] & (0x1 << off));
+static page_t *pt_window;
+static uint16_t pt_free[PT_WINDOW_SLOTS];
+static uint32_t npt_free = 0;
+static _Bool pt_ready = 0;
+
+static void init_pt_window();
+
+// the kernel half is the same in every directory, its translations survive cr3 switches when pge is enabled
+static inline int is_global(uint32_t vaddr) {
+    return vaddr >= KHEAP_START;
 }
 
-static uint32_t first_frame() {
-    uint32_t i, j;
-    for (i = 0; i < INDEX_FROM_BIT(nframes); i++) {
-        if (frames[i] != 0xFFFFFFFF) {
-            for (j = 0; j < 32; j++) {
-                uint32_t test = 0x1 << j;
-                if (!(frames[i] & test)) {
-                    return i * 4 * 8 + j;
-                }
-            }
-        }
+
+/*
+    a single frame, reclaiming memory when the buddy allocator is empty: clean file pages first,
+    then the zeroed pool and last user pages pushed out to swap. FRAME_NONE when nothing is left
+*/
+uint32_t take_frame() {
+    uint32_t idx = buddy_alloc(0);
+    if (idx == FRAME_NONE && pcache_shrink() > 0) {
+        idx = buddy_alloc(0);
+    }
+    if (idx == FRAME_NONE) {
+        idx = zpool_pop();
+    }
+    while (idx == FRAME_NONE && swap_out()) {
+        idx = buddy_alloc(0);
     }
-}
 
+    return idx;
+}
 
 void alloc_frame(page_t *page, int kernel, int writable) {
     if (page->frame != 0) {
         return;
     } else {
-        uint32_t idx = first_frame();
-        assert(idx != (uint32_t) - 1);
-        set_frame(idx);
+        uint32_t idx = take_frame();
+        assert(idx != FRAME_NONE);
         page->present = 1;
         page->rw = (writable) ? 1 : 0;
         page->user = (kernel) ? 0 : 1;
+        page->accessed = 1; // a new page gets a full round of the swap clock
         page->frame = idx;
     }
 }
 
+// same as alloc_frame(), but the page is guaranteed to read as zeroes
+void alloc_frame_zeroed(page_t *page, int kernel, int writable) {
+    if (page->frame != 0) {
+        return;
+    }
+
+    uint32_t idx = zpool_alloc();
+    while (idx == FRAME_NONE && swap_out()) {
+        idx = zpool_alloc();
+    }
+    assert(idx != FRAME_NONE);
+    page->present = 1;
+    page->rw = (writable) ? 1 : 0;
+    page->user = (kernel) ? 0 : 1;
+    page->accessed = 1;
+    page->frame = idx;
+}
+
 void free_frame(page_t *page) {
     uint32_t frame;
-    if (!(frame = page->frame)) {
+    if (!page || !(frame = page->frame)) {
         return;
+    } else if (page->swapped) {
+        swap_free(page);
     } else {
-        clear_frame(frame);
+        frame_unref(frame);
+        page->present = 0;
+        page->cow = 0;
         page->frame = 0x0;
     }
 }
 
+static inline int is_large(uint32_t vaddr, pagedir_t *dir) {
+    return !dir->tables[vaddr / 0x400000] && (dir->tab_phy[vaddr / 0x400000] & PDE_LARGE);
+}
+
+/*
+    backs a virtual range with new frames, taking the largest physically contiguous
+    blocks the buddy allocator can give instead of going one frame at a time.
+    returns ENOMEM when it runs out of frames or page tables, the pages mapped so far stay mapped
+*/
+int map_frames(uint32_t vaddr, uint32_t size, int kernel, int writable, pagedir_t *dir) {
+    uint32_t npages = (size + 0xFFF) / 0x1000;
+
+    while (npages > 0) {
+        uint32_t order = 31 - __builtin_clz(npages);
+        if (order > BUDDY_MAX_ORDER) {
+            order = BUDDY_MAX_ORDER;
+        }
+
+        uint32_t frame;
+        while ((frame = buddy_alloc(order)) == FRAME_NONE && order > 0) {
+            order--;
+        }
+        if (frame == FRAME_NONE) {
+            frame = take_frame(); // single frames can still come from reclaim
+        }
+        if (frame == FRAME_NONE) {
+            return ENOMEM;
+        }
+
+        for (uint32_t i = 0; i < (1u << order); i++) {
+            if (is_large(vaddr + i * 0x1000, dir)) {
+                frame_unref(frame + i); // covered by a large page
+                continue;
+            }
+
+            page_t *page = get_page(vaddr + i * 0x1000, 1, dir);
+            if (!page) {
+                for (; i < (1u << order); i++) {
+                    frame_unref(frame + i);
+                }
+                return ENOMEM;
+            }
+
+            if (page->frame != 0) {
+                frame_unref(frame + i); // already backed
+                continue;
+            }
+
+            page->present = 1;
+            page->rw = (writable) ? 1 : 0;
+            page->user = (kernel) ? 0 : 1;
+            page->global = is_global(vaddr + i * 0x1000);
+            page->frame = frame + i;
+        }
 
-void map_memory(uint32_t addr, uint32_t vaddr, uint32_t size, pagedir_t *dir, int use_existing_phys, uint8_t user) {
+        vaddr += (1 << order) * 0x1000;
+        npages -= 1 << order;
+    }
+
+    return 0;
+}
+
+// ENOMEM when a page table can not be allocated, pages under a large page are left as they are
+int map_memory(uint32_t addr, uint32_t vaddr, uint32_t size, pagedir_t *dir, int use_existing_phys, uint8_t user) {
     if (size < 0x1000) {
         size = 0x1000;
     }
@@ -92,7 +183,14 @@ void map_memory(uint32_t addr, uint32_t vaddr, uint32_t size, pagedir_t *dir, in
         uint32_t page_addr = addr + i * 0x1000;
         uint32_t page_vaddr = vaddr + i * 0x1000;
 
+        if (is_large(page_vaddr, dir)) {
+            continue;
+        }
+
         page_t *page = get_page(page_vaddr, 1, dir);
+        if (!page) {
+            return ENOMEM;
+        }
 
         if (!page->present) {
             if (use_existing_phys) {
@@ -103,10 +201,11 @@ void map_memory(uint32_t addr, uint32_t vaddr, uint32_t size, pagedir_t *dir, in
             } else {
                 alloc_frame(page, 1, 1);
             }
+            page->global = is_global(page_vaddr);
         }
     }
 
-    switch_page_dir(dir);
+    return 0;
 }
 
 void unmap_memory(uint32_t vaddr, uint32_t size, pagedir_t *dir) {
@@ -120,48 +219,199 @@ void unmap_memory(uint32_t vaddr, uint32_t size, pagedir_t *dir) {
         uint32_t page_vaddr = vaddr + i * 0x1000;
 
         page_t *page = get_page(page_vaddr, 0, dir);
+        if (!page) {
+            continue;
+        }
 
         page->present = 0;
         page->rw = 0;
         page->user = 0;
+        page->cow = 0;
 
-        clear_frame(page->frame);
+        frame_unref(page->frame);
         page->frame = 0;
+
+        flush_page(page_vaddr);
+    }
+}
+
+/*
+    maps a physically contiguous range with global 4 mib pages. both addresses have to be 4 mib
+    aligned and the range must not already have page tables
+*/
+static void map_large(uint32_t addr, uint32_t vaddr, uint32_t size, int user, pagedir_t *dir) {
+    assert((addr & 0x3FFFFF) == 0 && (vaddr & 0x3FFFFF) == 0);
+
+    for (uint32_t off = 0; off < size; off += 0x400000) {
+        uint32_t tab_idx = (vaddr + off) / 0x400000;
+        assert(!dir->tables[tab_idx]);
+
+        dir->tab_phy[tab_idx] = (addr + off) | PDE_LARGE | PDE_RW | PDE_PRESENT | PDE_GLOBAL | ((user) ? PDE_USER : 0);
+    }
+}
+
+// 4 mib pages (pse) and global pages (pge) are used when the cpu reports them
+static void init_paging_features() {
+    if (!cpuid_support) {
+        return;
+    }
+
+    uint32_t eax, ebx, ecx, edx;
+    __cpuid(1, &eax, &ebx, &ecx, &edx);
+
+    uint32_t cr4;
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+
+    if (edx & (1 << 3)) {
+        cr4 |= 0x10;
+        pse = 1;
+    }
+    if (edx & (1 << 13)) {
+        cr4 |= 0x80;
+        pge = 1;
     }
 
-    switch_page_dir(dir);
+    asm volatile("mov %0, %%cr4" :: "r"(cr4));
 }
 
-void init_paging() {
-    uint32_t mem_end = 0x2000000;
+// highest usable physical address according to the bootloader
+static uint32_t probe_memory(struct mboot_info *mboot) {
+    if (!(mboot->flags & MBOOT_FLAG_MMAP)) {
+        // mem_upper is the amount of memory above 1 mb, in kb
+        return 0x100000 + mboot->mem_upper * 1024;
+    }
 
-    nframes = mem_end / 0x1000;
-    frames = (uint32_t *) kmalloc(INDEX_FROM_BIT(nframes));
-    memset(frames, 0, INDEX_FROM_BIT(nframes));
+    uint64_t mem_end = 0;
+    uint32_t off = 0;
+    while (off < mboot->mmap_length) {
+        struct mboot_mmap_entry *e = (struct mboot_mmap_entry *) (mboot->mmap_addr + off);
 
-    uint32_t addr;
-    kernel_dir = (pagedir_t *) kmalloc_a(sizeof(pagedir_t));
-    memset(kernel_dir, 0, sizeof(pagedir_t));
-    kernel_dir->addr = (uint32_t) kernel_dir->tab_phy;
+        if (e->type == MBOOT_MMAP_AVAILABLE && e->addr + e->len > mem_end) {
+            mem_end = e->addr + e->len;
+        }
+
+        off += e->size + sizeof(e->size);
+    }
+
+    // no pae, frames above 4 gb cannot be mapped
+    if (mem_end > 0xFFFFF000) {
+        mem_end = 0xFFFFF000;
+    }
+
+    return (uint32_t) mem_end & 0xFFFFF000;
+}
+
+// hands every available region above the identity map to the frame allocator, reserved and acpi memory stays out
+static void add_memory(struct mboot_info *mboot, uint32_t identity_end, uint32_t mem_end) {
+    if (!(mboot->flags & MBOOT_FLAG_MMAP)) {
+        if (mem_end > identity_end) {
+            buddy_add_range(identity_end / 0x1000, (mem_end - identity_end) / 0x1000);
+        }
+        return;
+    }
+
+    uint32_t off = 0;
+    while (off < mboot->mmap_length) {
+        struct mboot_mmap_entry *e = (struct mboot_mmap_entry *) (mboot->mmap_addr + off);
+        off += e->size + sizeof(e->size);
+
+        if (e->type != MBOOT_MMAP_AVAILABLE || e->addr >= mem_end) {
+            continue;
+        }
+
+        uint64_t start = e->addr;
+        uint64_t end = e->addr + e->len;
+
+        if (start < identity_end) start = identity_end;
+        if (end > mem_end) end = mem_end;
 
-    int i = 0;
-    while (i < 0x400000) {
-        alloc_frame(get_page(i, 1, kernel_dir), 0, 0);
-        i += 0x1000;
+        start = (start + 0xFFF) & ~0xFFFULL;
+        end &= ~0xFFFULL;
+
+        if (start < end) {
+            buddy_add_range(start / 0x1000, (end - start) / 0x1000);
+        }
     }
+}
 
-    for (i = KHEAP_START; i < KHEAP_START + KHEAP_INITIAL_SZ; i += 0x1000) {
-        alloc_frame(get_page(i, 1, kernel_dir), 0, 0);
+void init_paging(struct mboot_info *mboot) {
+    uint32_t mem_end = probe_memory(mboot);
+
+    init_buddy(mem_end / 0x1000);
+
+    kernel_dir = (pagedir_t *) kmalloc(sizeof(pagedir_t));
+    memset(kernel_dir, 0, sizeof(pagedir_t));
+    kernel_dir->tab_phy = (uint32_t *) alloc_table(&kernel_dir->addr);
+
+    init_paging_features();
+    init_kmap();
+    init_pt_window();
+
+    uint32_t i;
+    uint32_t identity_end;
+
+    if (pse) {
+        /*
+            the kernel image and every placement allocation are covered by supervisor only 4 mib pages,
+            one more page is kept for the kernel heap descriptor. the identity map ends on a large page
+            boundary, a frame given out later must not stay reachable through the alias
+        */
+        identity_end = (placement_addr + 0x1000 + 0x3FFFFF) & ~0x3FFFFF;
+        map_large(0, 0, identity_end, 0, kernel_dir);
+    } else {
+        // create the kernel heap and framebuffer page tables first so that they end up inside the identity map
+        for (i = KHEAP_START; i < KHEAP_START + KHEAP_INITIAL_SZ; i += 0x400000) {
+            get_page(i, 1, kernel_dir);
+        }
+        for (i = LFB_VADDR; i < LFB_VADDR + LFB_SIZE; i += 0x400000) {
+            get_page(i, 1, kernel_dir);
+        }
+
+        /*
+            identity map the kernel image and every placement allocation, including the frame map and
+            the tables created by this loop. one more page is kept for the kernel heap descriptor
+        */
+        i = 0;
+        while (i < placement_addr + 0x1000) {
+            page_t *page = get_page(i, 1, kernel_dir);
+            page->present = 1;
+            page->rw = 1;
+            page->user = 0; // kernel image, frame map and early tables, user tasks must not reach them
+            page->global = 1;
+            page->frame = i / 0x1000;
+            i += 0x1000;
+        }
+        identity_end = i;
     }
 
-    map_memory(LFB_PHYS_ADDR, LFB_VADDR, LFB_SIZE, kernel_dir, 1, 1);
+    // everything above the identity map goes to the frame allocator
+    add_memory(mboot, identity_end, mem_end);
+
+    serial_printf("Physical memory: %d MiB, %d frames usable\n", mem_end / 0x100000, free_frames);
+
+    if (pse) {
+        // the first 4 mib of the kernel heap are one order 10 block, expand() finds them already mapped
+        uint32_t frame = buddy_alloc(BUDDY_MAX_ORDER);
+        assert(frame != FRAME_NONE);
+        map_large(frame * 0x1000, KHEAP_START, 0x400000, 0, kernel_dir);
+
+        map_large(LFB_PHYS_ADDR, LFB_VADDR, LFB_SIZE, 1, kernel_dir);
+    } else {
+        int err = map_frames(KHEAP_START, KHEAP_INITIAL_SZ, 1, 1, kernel_dir);
+        assert(err == 0);
+
+        err = map_memory(LFB_PHYS_ADDR, LFB_VADDR, LFB_SIZE, kernel_dir, 1, 1);
+        assert(err == 0);
+    }
 
     register_interrupt_handler(0x0E, pgf);
     switch_page_dir(kernel_dir);
+    pt_ready = 1;
 
     kheap = mkheap(KHEAP_START, KHEAP_START + KHEAP_INITIAL_SZ, 0xCFFFF000, 0, 0);
+    assert(placement_addr <= identity_end);
 
-    serial_printf("Kernel heap initialized at 0x%x\n", KHEAP_START);
+    serial_printf("Kernel heap initialized at 0x%x (pse = %d, pge = %d)\n", KHEAP_START, pse, pge);
 }
 
 void switch_page_dir(pagedir_t *dir) {
@@ -174,12 +424,95 @@ void switch_page_dir(pagedir_t *dir) {
         for(;;);
     }
 
-    asm volatile("mov %0, %%cr3" :: "r"(dir->addr));
+    // reloading the same directory would only throw the tlb away
+    uint32_t cr3;
+    asm volatile("mov %%cr3, %0" : "=r"(cr3));
+    if (cr3 != dir->addr) {
+        asm volatile("mov %0, %%cr3" :: "r"(dir->addr) : "memory");
+    }
 
+    // paging + write protect, so that kernel writes to shared pages fault as well
     uint32_t cr0;
     asm volatile("mov %%cr0, %0" : "=r"(cr0));
-    cr0 |= 0x80000000;
-    asm volatile("mov %0, %%cr0" :: "r"(cr0));
+    if ((cr0 & 0x80010000) != 0x80010000) {
+        cr0 |= 0x80010000;
+        asm volatile("mov %0, %%cr0" :: "r"(cr0));
+    }
+}
+
+// has to run before the identity map is built, the window's page table comes from the placement allocator
+static void init_pt_window() {
+    pt_window = get_page(PT_WINDOW_BASE, 1, kernel_dir);
+
+    for (int i = PT_WINDOW_SLOTS - 1; i >= 0; i--) {
+        pt_free[npt_free++] = i;
+    }
+}
+
+/*
+    a zeroed page for a page table or a page directory. until the kernel directory is loaded the
+    placement allocator is used, those tables are identity mapped and never freed. afterwards the
+    frame comes from the zero pool and gets a slot in the window, so nothing is taken from the heap.
+    returns NULL when no frame or window slot is left
+*/
+pagetab_t *alloc_table(uint32_t *phys) {
+    if (!pt_ready) {
+        pagetab_t *tab = (pagetab_t *) kmalloc_ap(sizeof(pagetab_t), phys);
+        memset(tab, 0, sizeof(pagetab_t));
+        return tab;
+    }
+
+    uint32_t frame = zpool_alloc();
+    if (frame == FRAME_NONE) {
+        return NULL;
+    }
+
+    uint32_t eflags;
+    asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+
+    if (npt_free == 0) {
+        asm volatile("push %0; popf" :: "r"(eflags) : "memory", "cc");
+        frame_unref(frame);
+        return NULL;
+    }
+
+    uint32_t slot = pt_free[--npt_free];
+    uint32_t vaddr = PT_WINDOW_BASE + slot * 0x1000;
+
+    pt_window[slot].present = 1;
+    pt_window[slot].rw = 1;
+    pt_window[slot].user = 0;
+    pt_window[slot].global = pge;
+    pt_window[slot].frame = frame;
+    flush_page(vaddr);
+
+    asm volatile("push %0; popf" :: "r"(eflags) : "memory", "cc");
+
+    *phys = frame * 0x1000;
+    return (pagetab_t *) vaddr;
+}
+
+void free_table(pagetab_t *tab) {
+    uint32_t vaddr = (uint32_t) tab;
+    if (vaddr < PT_WINDOW_BASE || vaddr >= PT_WINDOW_BASE + PT_WINDOW_SLOTS * 0x1000) {
+        return; // placement table
+    }
+
+    uint32_t slot = (vaddr - PT_WINDOW_BASE) / 0x1000;
+    uint32_t frame = pt_window[slot].frame;
+
+    uint32_t eflags;
+    asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+
+    pt_window[slot].present = 0;
+    pt_window[slot].global = 0;
+    pt_window[slot].frame = 0;
+    flush_page(vaddr);
+    pt_free[npt_free++] = slot;
+
+    asm volatile("push %0; popf" :: "r"(eflags) : "memory", "cc");
+
+    frame_unref(frame);
 }
 
 page_t *get_page(uint32_t addr, int make, pagedir_t *dir) {
@@ -187,10 +520,16 @@ page_t *get_page(uint32_t addr, int make, pagedir_t *dir) {
     uint32_t tab_idx = addr / 1024;
     if (dir->tables[tab_idx]) {
         return &dir->tables[tab_idx]->pages[addr % 1024];
+    } else if (dir->tab_phy[tab_idx] & PDE_LARGE) {
+        return 0; // no page table behind a 4 mib page
     } else if (make) {
         uint32_t tmp = 0;
-        dir->tables[tab_idx] = (pagetab_t *) kmalloc_ap(sizeof(pagetab_t), &tmp);
-        memset(dir->tables[tab_idx], 0, 0x1000);
+        pagetab_t *tab = alloc_table(&tmp);
+        if (!tab) {
+            return 0; // out of frames or window slots
+        }
+
+        dir->tables[tab_idx] = tab;
         dir->tab_phy[tab_idx] = tmp | 0x7;
         return &dir->tables[tab_idx]->pages[addr % 1024];
     } else {
@@ -198,13 +537,106 @@ page_t *get_page(uint32_t addr, int make, pagedir_t *dir) {
     }
 }
 
+// first write to a shared page, the writer gets its own copy unless it is the last one mapping the frame
+static void cow_fault(page_t *page, uint32_t addr) {
+    uint32_t old = page->frame;
+
+    if (frame_refs(old) > 1) {
+        uint32_t frame = take_frame();
+        assert(frame != FRAME_NONE);
+
+        copy_frame(frame, old);
+        frame_unref(old);
+        page->frame = frame;
+    }
+
+    page->rw = 1;
+    page->cow = 0;
+
+    flush_page(addr);
+}
+
+uint32_t get_phys(uint32_t vaddr, pagedir_t *dir) {
+    uint32_t tab_idx = vaddr / 0x400000;
+
+    if (is_large(vaddr, dir)) {
+        return (dir->tab_phy[tab_idx] & 0xFFC00000) + (vaddr & 0x3FFFFF);
+    }
+
+    page_t *page = get_page(vaddr, 0, dir);
+    assert(page != 0);
+
+    return page->frame * 0x1000 + (vaddr & 0xFFF);
+}
+
+/*
+    kernel_dir gets new tables over time (kernel heap growth, process slots) while the other
+    directories only copied the entries present when they were cloned. the missing entry is
+    linked on the first fault instead of updating every directory
+*/
+static int sync_kernel_table(uint32_t addr) {
+    uint32_t tab_idx = addr / 0x400000;
+
+    if (crt_dir == kernel_dir || crt_dir->tab_phy[tab_idx] || !kernel_dir->tab_phy[tab_idx]) {
+        return 0;
+    }
+
+    crt_dir->tables[tab_idx] = kernel_dir->tables[tab_idx];
+    crt_dir->tab_phy[tab_idx] = kernel_dir->tab_phy[tab_idx];
+    return 1;
+}
+
 // #PF handler
+// faults are charged to the running task, major ones had to wait for the disk
+static void count_fault(int major) {
+    tcb_t *task = get_task(getpid());
+    if (task) {
+        task->faults++;
+        task->major_faults += major;
+    }
+}
+
 void pgf(regs_t *regs) {
-    asm volatile("cli");
-    
     uint32_t addr; // fault address
     asm volatile("mov %%cr2, %0" : "=r" (addr));
 
+    // protection violation on a write
+    if ((regs->err_code & 0x3) == 0x3) {
+        page_t *page = get_page(addr, 0, crt_dir);
+
+        if (page && page->cow) {
+            cow_fault(page, addr);
+            count_fault(0);
+            return;
+        }
+    }
+
+    // not present, process slots and file mappings are populated on first touch or read back from swap
+    if (!(regs->err_code & 0x1)) {
+        if (sync_kernel_table(addr)) {
+            return;
+        }
+
+        if (swap_fault(addr)) {
+            count_fault(1);
+            return;
+        }
+
+        if (bin_fault(addr) || mmap_fault(addr)) {
+            count_fault(0);
+            return;
+        }
+    }
+
+    // faulting user code only takes its own task down
+    if ((regs->err_code & 0x4) && getpid() != -1) {
+        serial_printf("Segmentation fault at 0x%x in task %d, eip = 0x%x, err = %d\n", addr, getpid(), regs->eip, regs->err_code);
+        kill_task(getpid(), SIGSEGV);
+        return;
+    }
+
+    asm volatile("cli");
+
     serial_printf("Unhandled page fault at 0x%x, err = %d\n", addr, regs->err_code);
 
     while (1) {
@@ -212,37 +644,63 @@ void pgf(regs_t *regs) {
     }
 }
 
+// drops the frames and swap slots a private table references together with the table
+static void drop_table(pagetab_t *tab) {
+    for (int i = 0; i < PAGE_TAB_SIZE; i++) {
+        free_frame(&tab->pages[i]);
+    }
+    free_table(tab);
+}
+
+/*
+    frames are shared instead of copied. writable pages become read only in both tables and are
+    marked copy on write, the copy is made by pgf() on the first write from either side.
+    swapped out pages are read back first, a slot can't be shared like a frame
+*/
 static pagetab_t *clone_table(pagetab_t *src, uint32_t *addr) {
-    pagetab_t *tab = (pagetab_t *) kmalloc_ap(sizeof(pagetab_t), addr);
-    memset(tab, 0, sizeof(pagedir_t));
+    pagetab_t *tab = alloc_table(addr);
+    if (!tab) {
+        return NULL;
+    }
 
     for (int i = 0; i < 1024; i++) {
-        if (src->pages[i].frame) {
-            alloc_frame(&tab->pages[i], 0, 0);
+        page_t *page = &src->pages[i];
+
+        if (!page->frame) {
+            continue;
+        }
 
-            if (src->pages[i].present)  tab->pages[i].present = 1;
-            if (src->pages[i].rw)       tab->pages[i].rw = 1;
-            if (src->pages[i].user)     tab->pages[i].user = 1;
-            if (src->pages[i].accessed) tab->pages[i].accessed = 1;
-            if (src->pages[i].dirty)    tab->pages[i].dirty = 1;
+        if (page->swapped && !swap_in(page)) {
+            drop_table(tab);
+            return NULL;
+        }
 
-            copy_page_physical(src->pages[i].frame * 0x1000, tab->pages[i].frame * 0x1000);
+        if (page->rw) {
+            page->rw = 0;
+            page->cow = 1;
         }
+
+        tab->pages[i] = *page;
+        frame_ref(page->frame);
     }
 
     return tab;
 }
 
 pagedir_t *clone_dir(pagedir_t *src) {
-    uint32_t phy;
-    pagedir_t *dir = (pagedir_t *) kmalloc_ap(sizeof(pagedir_t), &phy);
+    pagedir_t *dir = (pagedir_t *) kmalloc(sizeof(pagedir_t));
     memset(dir, 0, sizeof(pagedir_t));
+    dir->tab_phy = (uint32_t *) alloc_table(&dir->addr);
+    if (!dir->tab_phy) {
+        kfree(dir);
+        return NULL;
+    }
 
-    uint32_t off = (uint32_t) dir->tab_phy - (uint32_t) dir;
-    dir->addr = phy + off;
+    int cloned = 0;
 
     for (int i = 0; i < 1024; i++) {
         if (!src->tables[i]) {
+            dir->tab_phy[i] = (src->tab_phy[i] & PDE_LARGE) ? src->tab_phy[i] : 0; // 4 mib pages are always shared
             continue;
         }
 
@@ -251,10 +709,75 @@ pagedir_t *clone_dir(pagedir_t *src) {
             dir->tab_phy[i] = src->tab_phy[i];
         } else {
             uint32_t phy;
-            dir->tables[i] = clone_table(src->tables[i], &phy);
+            pagetab_t *tab = clone_table(src->tables[i], &phy);
+            if (!tab) {
+                free_dir(dir); // drops the tables cloned so far
+                dir = NULL;
+                break;
+            }
+
+            dir->tables[i] = tab;
             dir->tab_phy[i] = phy | 0x07;
+            cloned = 1;
         }
     }
 
+    // the source lost write access to its private pages
+    if (cloned && src == crt_dir) {
+        flush_tlb();
+    }
+
     return dir;
 }
+
+
+// a directory for a new task, taken from the pool when possible. NULL when no table is left
+pagedir_t *alloc_dir() {
+    if (ndir_pool > 0) {
+        return dir_pool[--ndir_pool];
+    }
+
+    return clone_dir(kernel_dir);
+}
+
+/*
+    frees every table the directory doesn't share with kernel_dir together with the frames they
+    reference, then keeps the directory for the next task or frees it when the pool is full
+*/
+void free_dir(pagedir_t *dir) {
+    assert(dir != kernel_dir && dir != crt_dir);
+
+    for (int i = 0; i < PAGE_DIR_SIZE; i++) {
+        pagetab_t *tab = dir->tables[i];
+
+        if (tab && tab != kernel_dir->tables[i]) {
+            drop_table(tab); // swapped out ptes give their slot back
+        }
+
+        // back to the state clone_dir(kernel_dir) would produce
+        dir->tables[i] = kernel_dir->tables[i];
+        dir->tab_phy[i] = kernel_dir->tab_phy[i];
+    }
+
+    if (ndir_pool < DIR_POOL_SIZE) {
+        dir_pool[ndir_pool++] = dir;
+    } else {
+        free_table((pagetab_t *) dir->tab_phy);
+        kfree(dir);
+    }
+}
+
+// called from the idle task so that task creation doesn't have to build a directory
+void dir_pool_refill() {
+    while (ndir_pool < DIR_POOL_SIZE) {
+        pagedir_t *dir = clone_dir(kernel_dir);
+        if (!dir) {
+            return;
+        }
+
+        uint32_t eflags;
+        asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+        dir_pool[ndir_pool++] = dir;
+        asm volatile("push %0; popf" :: "r"(eflags) : "memory", "cc");
+    }
+}
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include <string.h>
+
+#include <asm/io.h>
+#include <mm/buddy.h>
+#include <mm/kheap.h>
+#include <mm/kmap.h>
+#include <mm/pcache.h>
+#include <mm/slab.h>
+#include <mm/zpool.h>
+
+/*
+    page cache for skbdfs files, keyed by (first block of the node, page index).
+    the cache owns one reference on every cached frame, mappings take their own, so a page
+    stays valid in the tasks that map it even after it has been dropped from the cache
+*/
+
+static pcache_entry_t *buckets[PCACHE_BUCKETS];
+static kmem_cache_t *entry_cache;
+
+uint32_t pcache_hits = 0;
+uint32_t pcache_misses = 0;
+uint32_t pcache_pages = 0;
+
+
+static inline uint32_t hash(uint32_t ino, uint32_t index) {
+    return (ino * 31 + index) % PCACHE_BUCKETS;
+}
+
+void init_pcache() {
+    entry_cache = kmem_cache_create("pcache_entry", sizeof(pcache_entry_t), 0, NULL);
+}
+
+// reads a page of the file into a zeroed frame, the part past the end of the file stays zero
+static uint32_t fill(node_t *node, uint32_t index) {
+    uint8_t *buffer = (uint8_t *) kmalloc(PAGE_SIZE);
+    int n = fread_at(node, index * PAGE_SIZE, PAGE_SIZE, buffer);
+
+    uint32_t frame = zpool_alloc();
+    if (n > 0 && frame != FRAME_NONE) {
+        uint32_t eflags;
+        asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+
+        memcpy(kmap(frame, KMAP_DST), buffer, n);
+        kunmap(KMAP_DST);
+
+        asm volatile("push %0; popf" :: "r"(eflags) : "memory", "cc");
+    }
+
+    kfree(buffer);
+    return frame;
+}
+
+/*
+    returns the frame holding page index of the file, reading it from the drive on a miss.
+    the caller gets its own reference and releases it with frame_unref()
+*/
+uint32_t pcache_get(node_t *node, uint32_t index) {
+    uint32_t ino = node->first_block;
+    uint32_t h = hash(ino, index);
+
+    for (pcache_entry_t *e = buckets[h]; e; e = e->next) {
+        if (e->ino == ino && e->index == index) {
+            pcache_hits++;
+            frame_ref(e->frame);
+            return e->frame;
+        }
+    }
+
+    pcache_misses++;
+
+    uint32_t frame = fill(node, index);
+    if (frame == FRAME_NONE) {
+        return FRAME_NONE;
+    }
+
+    pcache_entry_t *e = (pcache_entry_t *) kmem_cache_alloc(entry_cache);
+    e->ino = ino;
+    e->index = index;
+    e->frame = frame;
+    e->next = buckets[h];
+    buckets[h] = e;
+    pcache_pages++;
+
+    frame_ref(frame);
+    return frame;
+}
+
+// drops every cached page of a file
+void pcache_invalidate(uint32_t ino) {
+    for (int h = 0; h < PCACHE_BUCKETS; h++) {
+        pcache_entry_t **link = &buckets[h];
+
+        while (*link) {
+            pcache_entry_t *e = *link;
+
+            if (e->ino == ino) {
+                *link = e->next;
+                frame_unref(e->frame);
+                kmem_cache_free(entry_cache, e);
+                pcache_pages--;
+            } else {
+                link = &e->next;
+            }
+        }
+    }
+}
+
+// frees the pages nobody maps anymore, returns the number of frames given back
+uint32_t pcache_shrink() {
+    uint32_t freed = 0;
+
+    for (int h = 0; h < PCACHE_BUCKETS; h++) {
+        pcache_entry_t **link = &buckets[h];
+
+        while (*link) {
+            pcache_entry_t *e = *link;
+
+            if (frame_refs(e->frame) == 1) {
+                *link = e->next;
+                frame_unref(e->frame);
+                kmem_cache_free(entry_cache, e);
+                pcache_pages--;
+                freed++;
+            } else {
+                link = &e->next;
+            }
+        }
+    }
+
+    return freed;
+}
+
+void pcache_dump() {
+    serial_printf("pcache: %d pages, %d hits, %d misses\n", pcache_pages, pcache_hits, pcache_misses);
+}
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include <errno.h>
+
+#include <asm/io.h>
+#include <int/task.h>
+#include <mm/buddy.h>
+#include <mm/kheap.h>
+#include <mm/shm.h>
+#include <mm/zpool.h>
+
+/*
+    every frame keeps one reference for the segment itself and one for every directory that maps
+    it. shm_destroy() drops the segment's reference, so the frames go back to the buddy allocator
+    with the last shm_unmap()
+*/
+
+static shm_t segments[SHM_MAX_SEGS];
+
+
+static shm_t *segment(uint32_t addr) {
+    if (addr < SHM_BASE || addr >= SHM_BASE + SHM_MAX_SEGS * SHM_SEG_SIZE) {
+        return NULL;
+    }
+
+    shm_t *shm = &segments[(addr - SHM_BASE) / SHM_SEG_SIZE];
+    return (shm->used) ? shm : NULL;
+}
+
+static uint32_t seg_addr(shm_t *shm) {
+    return SHM_BASE + (shm - segments) * SHM_SEG_SIZE;
+}
+
+static void seg_free(shm_t *shm) {
+    kfree(shm->frames);
+    shm->frames = NULL;
+    shm->used = 0;
+}
+
+// creates a zeroed segment and maps it into dir, returns its address or 0
+uint32_t shm_create(uint32_t size, pagedir_t *dir) {
+    if (size == 0 || size > SHM_SEG_SIZE) {
+        return 0;
+    }
+
+    size = (size + 0xFFF) & 0xFFFFF000;
+    if (size / 0x1000 > free_frames) {
+        return 0;
+    }
+
+    shm_t *shm = NULL;
+    for (int i = 0; i < SHM_MAX_SEGS; i++) {
+        if (!segments[i].used) {
+            shm = &segments[i];
+            break;
+        }
+    }
+    if (!shm) {
+        return 0;
+    }
+
+    shm->frames = (uint32_t *) kmalloc(size / 0x1000 * sizeof(uint32_t));
+    for (uint32_t i = 0; i < size / 0x1000; i++) {
+        shm->frames[i] = zpool_alloc();
+    }
+
+    shm->size = size;
+    shm->maps = 0;
+    shm->owner = getpid();
+    shm->used = 1;
+    shm->destroyed = 0;
+
+    uint32_t addr = shm_map(seg_addr(shm), dir);
+    if (addr == 0) {
+        shm_destroy(seg_addr(shm)); // no page table for the mapping
+    }
+
+    return addr;
+}
+
+uint32_t shm_map(uint32_t addr, pagedir_t *dir) {
+    shm_t *shm = segment(addr);
+    if (!shm || shm->destroyed) {
+        return 0;
+    }
+
+    addr = seg_addr(shm);
+    if (dir->tables[addr / 0x400000]) {
+        return addr; // already mapped
+    }
+
+    // the segment has one table to itself, it is the only allocation that can fail
+    if (!get_page(addr, 1, dir)) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < shm->size / 0x1000; i++) {
+        page_t *page = get_page(addr + i * 0x1000, 1, dir);
+        page->present = 1;
+        page->rw = 1;
+        page->user = 1;
+        page->frame = shm->frames[i];
+
+        frame_ref(shm->frames[i]);
+    }
+
+    shm->maps++;
+    return addr;
+}
+
+int shm_unmap(uint32_t addr, pagedir_t *dir) {
+    shm_t *shm = segment(addr);
+    if (!shm) {
+        return EINVAL;
+    }
+
+    addr = seg_addr(shm);
+    uint32_t tab_idx = addr / 0x400000;
+    if (!dir->tables[tab_idx]) {
+        return EINVAL;
+    }
+
+    for (uint32_t i = 0; i < shm->size / 0x1000; i++) {
+        frame_unref(shm->frames[i]);
+
+        if (dir == crt_dir) {
+            flush_page(addr + i * 0x1000);
+        }
+    }
+
+    free_table(dir->tables[tab_idx]);
+    dir->tables[tab_idx] = NULL;
+    dir->tab_phy[tab_idx] = 0;
+
+    if (--shm->maps == 0 && shm->destroyed) {
+        seg_free(shm);
+    }
+
+    return 0;
+}
+
+// the segment can't be mapped anymore, its memory is freed once every task has unmapped it
+int shm_destroy(uint32_t addr) {
+    shm_t *shm = segment(addr);
+    if (!shm || shm->destroyed) {
+        return EINVAL;
+    }
+
+    shm->destroyed = 1;
+    for (uint32_t i = 0; i < shm->size / 0x1000; i++) {
+        frame_unref(shm->frames[i]);
+    }
+
+    if (shm->maps == 0) {
+        seg_free(shm);
+    }
+
+    return 0;
+}
+
+// pid of the task that created the segment at addr, -1 when there is no such segment
+int shm_owner(uint32_t addr) {
+    shm_t *shm = segment(addr);
+    return (shm && !shm->destroyed) ? shm->owner : -1;
+}
+
+_Bool shm_is_mapped(uint32_t addr, pagedir_t *dir) {
+    shm_t *shm = segment(addr);
+    return shm && dir->tables[addr / 0x400000] && addr - seg_addr(shm) < shm->size;
+}
+
+// task exit: drops every mapping of its directory and destroys the segments it created
+void shm_release(int pid, pagedir_t *dir) {
+    for (int i = 0; i < SHM_MAX_SEGS; i++) {
+        shm_t *shm = &segments[i];
+        uint32_t addr = seg_addr(shm);
+
+        if (shm->used && dir->tables[addr / 0x400000]) {
+            shm_unmap(addr, dir);
+        }
+        if (shm->used && shm->owner == pid && !shm->destroyed) {
+            shm_destroy(addr);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,237 @@
+#include <assert.h>
+#include <string.h>
+
+#include <asm/io.h>
+#include <mm/kheap.h>
+#include <mm/slab.h>
+
+#define BUFCTL(s) ((uint16_t *) ((uint32_t) (s) + sizeof(slab_t)))
+
+static kmem_cache_t *caches = NULL;
+
+
+static void slab_list_add(slab_t **list, slab_t *s) {
+    s->prev = NULL;
+    s->next = *list;
+    if (*list) {
+        (*list)->prev = s;
+    }
+    *list = s;
+}
+
+static void slab_list_del(slab_t **list, slab_t *s) {
+    if (s->prev) {
+        s->prev->next = s->next;
+    } else {
+        *list = s->next;
+    }
+
+    if (s->next) {
+        s->next->prev = s->prev;
+    }
+}
+
+static slab_t *new_slab(kmem_cache_t *cache) {
+    uint32_t mem = kmalloc_a(cache->pages * PAGE_SIZE);
+    if (!mem) {
+        return NULL;
+    }
+
+    slab_t *s;
+    if (cache->offslab) {
+        s = (slab_t *) kmalloc(sizeof(slab_t) + cache->objs * sizeof(uint16_t));
+        s->mem = mem;
+    } else {
+        // descriptor and bufctl live at the start of the page, objects follow
+        s = (slab_t *) mem;
+        s->mem = mem + cache->off;
+    }
+
+    s->inuse = 0;
+    s->free = 0;
+
+    uint16_t *bufctl = BUFCTL(s);
+    for (uint32_t i = 0; i < cache->objs; i++) {
+        bufctl[i] = (i + 1 < cache->objs) ? i + 1 : SLAB_END;
+
+        if (cache->ctor) {
+            cache->ctor((void *) (s->mem + i * cache->size));
+        }
+    }
+
+    cache->nslabs++;
+    cache->grows++;
+    return s;
+}
+
+static void destroy_slab(kmem_cache_t *cache, slab_t *s) {
+    if (cache->offslab) {
+        kfree((void *) s->mem);
+        kfree(s);
+    } else {
+        kfree(s);
+    }
+
+    cache->nslabs--;
+    cache->shrinks++;
+}
+
+static slab_t *find_slab(kmem_cache_t *cache, uint32_t obj) {
+    if (!cache->offslab) {
+        return (slab_t *) (obj & ~(PAGE_SIZE - 1));
+    }
+
+    // off-slab caches hold large objects, so they only have a handful of slabs
+    uint32_t len = cache->objs * cache->size;
+    slab_t *lists[2] = { cache->partial, cache->full };
+
+    for (int i = 0; i < 2; i++) {
+        for (slab_t *s = lists[i]; s != NULL; s = s->next) {
+            if (obj >= s->mem && obj < s->mem + len) {
+                return s;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+kmem_cache_t *kmem_cache_create(char *name, uint32_t size, uint32_t align, void (*ctor)(void *obj)) {
+    if (align < 4) {
+        align = 4;
+    }
+    size = (size + align - 1) & ~(align - 1);
+
+    kmem_cache_t *cache = (kmem_cache_t *) kcalloc(1, sizeof(kmem_cache_t));
+    if (!cache) {
+        return NULL;
+    }
+
+    strncpy(cache->name, name, sizeof(cache->name) - 1);
+    cache->size = size;
+    cache->ctor = ctor;
+
+    if (size <= SLAB_ONSLAB_MAX) {
+        cache->offslab = 0;
+        cache->pages = 1;
+        cache->objs = (PAGE_SIZE - sizeof(slab_t)) / (size + sizeof(uint16_t));
+
+        while (1) {
+            cache->off = (sizeof(slab_t) + cache->objs * sizeof(uint16_t) + align - 1) & ~(align - 1);
+            if (cache->off + cache->objs * size <= PAGE_SIZE) {
+                break;
+            }
+            cache->objs--;
+        }
+    } else {
+        cache->offslab = 1;
+        cache->pages = (SLAB_MIN_OBJS * size + PAGE_SIZE - 1) / PAGE_SIZE;
+        cache->objs = cache->pages * PAGE_SIZE / size;
+        cache->off = 0;
+    }
+
+    cache->next = caches;
+    caches = cache;
+
+    #ifdef DEBUG
+    serial_printf("kmem_cache_create(): %s size=%d objs=%d pages=%d\n", cache->name, cache->size, cache->objs, cache->pages);
+    #endif
+
+    return cache;
+}
+
+void kmem_cache_destroy(kmem_cache_t *cache) {
+    assert(cache->active == 0);
+
+    while (cache->empty) {
+        slab_t *s = cache->empty;
+        slab_list_del(&cache->empty, s);
+        destroy_slab(cache, s);
+    }
+
+    kmem_cache_t **it = &caches;
+    while (*it && *it != cache) {
+        it = &(*it)->next;
+    }
+    if (*it) {
+        *it = cache->next;
+    }
+
+    kfree(cache);
+}
+
+void *kmem_cache_alloc(kmem_cache_t *cache) {
+    slab_t *s = cache->partial;
+
+    if (s == NULL) {
+        s = cache->empty;
+        if (s != NULL) {
+            slab_list_del(&cache->empty, s);
+        } else if ((s = new_slab(cache)) == NULL) {
+            return NULL;
+        }
+
+        slab_list_add(&cache->partial, s);
+    }
+
+    uint16_t i = s->free;
+    s->free = BUFCTL(s)[i];
+    s->inuse++;
+
+    if (s->inuse == cache->objs) {
+        slab_list_del(&cache->partial, s);
+        slab_list_add(&cache->full, s);
+    }
+
+    cache->active++;
+    cache->allocs++;
+
+    return (void *) (s->mem + i * cache->size);
+}
+
+void kmem_cache_free(kmem_cache_t *cache, void *obj) {
+    if (obj == NULL) {
+        return;
+    }
+
+    slab_t *s = find_slab(cache, (uint32_t) obj);
+    assert(s != NULL);
+
+    uint32_t i = ((uint32_t) obj - s->mem) / cache->size;
+    assert(s->mem + i * cache->size == (uint32_t) obj);
+
+    if (s->inuse == cache->objs) {
+        slab_list_del(&cache->full, s);
+        slab_list_add(&cache->partial, s);
+    }
+
+    BUFCTL(s)[i] = s->free;
+    s->free = i;
+    s->inuse--;
+
+    cache->active--;
+    cache->frees++;
+
+    if (s->inuse == 0) {
+        slab_list_del(&cache->partial, s);
+
+        // keep one empty slab around, give the others back to the heap
+        if (cache->empty == NULL) {
+            slab_list_add(&cache->empty, s);
+        } else {
+            destroy_slab(cache, s);
+        }
+    }
+}
+
+void kmem_cache_dump(kmem_cache_t *cache) {
+    serial_printf("%s: size=%d objs/slab=%d slabs=%d active=%d/%d allocs=%d frees=%d grows=%d shrinks=%d\n",
+        cache->name, cache->size, cache->objs, cache->nslabs, cache->active, cache->nslabs * cache->objs,
+        cache->allocs, cache->frees, cache->grows, cache->shrinks);
+}
+
+void slab_dump() {
+    for (kmem_cache_t *cache = caches; cache != NULL; cache = cache->next) {
+        kmem_cache_dump(cache);
+    }
+}
\ No newline at end of file
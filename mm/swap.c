@@ -0,0 +1,303 @@
+#include <assert.h>
+#include <string.h>
+
+#include <hw/ata.h>
+#include <asm/io.h>
+#include <mm/buddy.h>
+#include <mm/kheap.h>
+#include <mm/kmap.h>
+#include <mm/paging.h>
+#include <mm/swap.h>
+
+/*
+    anonymous pages of the process slots can be pushed out to a raw swap drive. only the slots are
+    scanned, their page tables live in kernel_dir and are shared by every directory, so a single
+    pte has to be changed per page. a swapped out pte is not present, has the swapped bit set and
+    keeps the slot in its frame field.
+
+    victims are picked with a second chance clock over the accessed and dirty bits. a page that was
+    read back keeps its slot until the frame is written to or freed, so evicting it again while it
+    is clean costs no disk write. every swap operation runs with interrupts off, the ata driver polls
+*/
+
+extern _Bool addresses[MAX_PROCESS];
+
+uint32_t swap_ins = 0;
+uint32_t swap_outs = 0;
+
+static uint32_t nslots = 0;
+static uint32_t *slot_map; // bit set = slot in use, slot 0 is never handed out
+static uint32_t free_slots = 0;
+static uint16_t *frame_slot; // slot holding a clean copy of the frame, 0 = none
+
+static uint32_t hand = BIN_BASE_ADDR;
+
+
+static inline uint32_t irq_save() {
+    uint32_t eflags;
+    asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+    return eflags;
+}
+
+static inline void irq_restore(uint32_t eflags) {
+    asm volatile("push %0; popf" :: "r"(eflags) : "memory", "cc");
+}
+
+void init_swap() {
+    if (!ata_drive_present(SWAP_DRIVE)) {
+        serial_printf("swap: no drive %d, swapping disabled\n", SWAP_DRIVE);
+        return;
+    }
+
+    nslots = get_drive_size(SWAP_DRIVE) / (PAGE_SIZE / 1024);
+    if (nslots > SWAP_MAX_SLOTS) {
+        nslots = SWAP_MAX_SLOTS;
+    }
+    if (nslots < 2) {
+        nslots = 0;
+        return;
+    }
+
+    slot_map = (uint32_t *) kcalloc((nslots + 31) / 32, sizeof(uint32_t));
+    slot_map[0] = 1;
+    free_slots = nslots - 1;
+
+    frame_slot = (uint16_t *) kcalloc(nframes, sizeof(uint16_t));
+
+    serial_printf("swap: %d slots (%d MiB) on drive %d\n", nslots, nslots / 256, SWAP_DRIVE);
+}
+
+static uint32_t alloc_slot() {
+    if (free_slots == 0) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < (nslots + 31) / 32; i++) {
+        if (slot_map[i] == 0xFFFFFFFF) {
+            continue;
+        }
+
+        uint32_t slot = i * 32 + __builtin_ctz(~slot_map[i]);
+        if (slot >= nslots) {
+            break;
+        }
+
+        slot_map[i] |= 1 << (slot % 32);
+        free_slots--;
+        return slot;
+    }
+
+    return 0;
+}
+
+static void free_slot(uint32_t slot) {
+    assert(slot != 0 && slot < nslots);
+
+    slot_map[slot / 32] &= ~(1 << (slot % 32));
+    free_slots++;
+}
+
+static int write_slot(uint32_t slot, uint32_t frame) {
+    void *src = kmap(frame, KMAP_SRC);
+    int ret = ata_write_sectors(SWAP_DRIVE, slot * SWAP_SECTORS, SWAP_SECTORS, (uint8_t *) src);
+    kunmap(KMAP_SRC);
+
+    return ret;
+}
+
+static int read_slot(uint32_t slot, uint32_t frame) {
+    void *dst = kmap(frame, KMAP_DST);
+    int ret = ata_read_sectors(SWAP_DRIVE, slot * SWAP_SECTORS, SWAP_SECTORS, (uint8_t *) dst);
+    kunmap(KMAP_DST);
+
+    return ret;
+}
+
+/*
+    looks at the page under the hand and moves the hand on. *step is the number of pages passed,
+    unused slots and missing page tables are skipped as a whole. only private user pages qualify,
+    shared frames (cow copies, page cache) stay in memory
+*/
+static page_t *clock_step(uint32_t *vaddr, uint32_t *step) {
+    uint32_t addr = hand;
+    page_t *page = NULL;
+
+    if (!addresses[(addr - BIN_BASE_ADDR) / MAX_PROCESS_SIZE]) {
+        *step = (MAX_PROCESS_SIZE - (addr - BIN_BASE_ADDR) % MAX_PROCESS_SIZE) / PAGE_SIZE;
+    } else if (!kernel_dir->tables[addr / 0x400000]) {
+        *step = (0x400000 - addr % 0x400000) / PAGE_SIZE;
+    } else {
+        *step = 1;
+        page = &kernel_dir->tables[addr / 0x400000]->pages[(addr / PAGE_SIZE) % PAGE_TAB_SIZE];
+
+        if (!page->present || !page->user || frame_refs(page->frame) != 1) {
+            page = NULL;
+        }
+    }
+
+    hand += *step * PAGE_SIZE;
+    if (hand >= BIN_END_ADDR || hand < BIN_BASE_ADDR) {
+        hand = BIN_BASE_ADDR;
+    }
+
+    *vaddr = addr;
+    return page;
+}
+
+static int evict(page_t *page, uint32_t vaddr) {
+    uint32_t frame = page->frame;
+    uint32_t slot = frame_slot[frame];
+
+    // a clean page with a copy in swap is dropped without any i/o
+    if (slot == 0 || page->dirty) {
+        if (slot == 0 && (slot = alloc_slot()) == 0) {
+            return 0;
+        }
+
+        if (write_slot(slot, frame) != 0) {
+            if (frame_slot[frame] == 0) {
+                free_slot(slot);
+            }
+            return 0;
+        }
+    }
+
+    frame_slot[frame] = 0;
+
+    page->present = 0;
+    page->accessed = 0;
+    page->dirty = 0;
+    page->swapped = 1;
+    page->frame = slot;
+    flush_page(vaddr);
+
+    frame_unref(frame);
+    swap_outs++;
+    return 1;
+}
+
+/*
+    frees one frame by evicting a user page, returns 0 when there is nothing to evict.
+    the first sweep only takes pages that are neither accessed nor dirty, the second takes any page
+    that is not accessed and clears the accessed bit of the others, the third finds one of those
+*/
+int swap_out() {
+    if (nslots == 0) {
+        return 0;
+    }
+
+    uint32_t eflags = irq_save();
+    uint32_t user_pages = (BIN_END_ADDR - BIN_BASE_ADDR) / PAGE_SIZE;
+
+    for (int pass = 0; pass < 3; pass++) {
+        uint32_t scanned = 0;
+
+        while (scanned < user_pages) {
+            uint32_t vaddr, step;
+            page_t *page = clock_step(&vaddr, &step);
+            scanned += step;
+
+            if (!page) {
+                continue;
+            }
+
+            if (page->accessed) {
+                if (pass > 0) {
+                    page->accessed = 0;
+                    flush_page(vaddr);
+                }
+                continue;
+            }
+
+            if (pass == 0 && page->dirty && frame_slot[page->frame] == 0) {
+                continue;
+            }
+
+            if (evict(page, vaddr)) {
+                irq_restore(eflags);
+                return 1;
+            }
+        }
+    }
+
+    irq_restore(eflags);
+    return 0;
+}
+
+// called from pgf() for a not present fault, reads the page back into a new frame
+int swap_fault(uint32_t addr) {
+    if (nslots == 0 || addr < BIN_BASE_ADDR || addr >= BIN_END_ADDR) {
+        return 0;
+    }
+
+    page_t *page = get_page(addr, 0, kernel_dir);
+    if (!page || page->present || !page->swapped) {
+        return 0;
+    }
+
+    if (!swap_in(page)) {
+        return 0;
+    }
+
+    flush_page(addr & 0xFFFFF000);
+    return 1;
+}
+
+// reads a swapped out pte back into a new frame, 0 when no frame is left or the read fails
+int swap_in(page_t *page) {
+    assert(page->swapped);
+
+    uint32_t eflags = irq_save();
+
+    uint32_t frame = take_frame();
+    if (frame == FRAME_NONE) {
+        irq_restore(eflags);
+        return 0;
+    }
+
+    uint32_t slot = page->frame;
+    if (read_slot(slot, frame) != 0) {
+        frame_unref(frame);
+        irq_restore(eflags);
+        return 0;
+    }
+
+    // the slot stays allocated as the clean copy of the frame
+    frame_slot[frame] = slot;
+
+    page->swapped = 0;
+    page->frame = frame;
+    page->present = 1;
+    page->accessed = 1;
+    page->dirty = 0;
+
+    swap_ins++;
+    irq_restore(eflags);
+    return 1;
+}
+
+// drops a swapped out pte together with its slot
+void swap_free(page_t *page) {
+    assert(page->swapped);
+
+    uint32_t eflags = irq_save();
+    free_slot(page->frame);
+    irq_restore(eflags);
+
+    page->swapped = 0;
+    page->frame = 0;
+}
+
+// called by the frame allocator when a frame is freed, its copy in swap is no longer needed
+void swap_forget(uint32_t frame) {
+    if (nslots == 0 || frame_slot[frame] == 0) {
+        return;
+    }
+
+    free_slot(frame_slot[frame]);
+    frame_slot[frame] = 0;
+}
+
+void swap_dump() {
+    serial_printf("swap: %d/%d slots free, %d ins, %d outs\n", free_slots, nslots - 1, swap_ins, swap_outs);
+}
\ No newline at end of file
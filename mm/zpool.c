@@ -0,0 +1,81 @@
+#include <asm/io.h>
+#include <mm/buddy.h>
+#include <mm/kmap.h>
+#include <mm/zpool.h>
+
+/*
+    frames that have already been zeroed, filled by the idle task so that page faults and new
+    mappings don't have to clear memory inline. the pool and the buddy allocator are shared with
+    the #PF handler, every access happens with interrupts off
+*/
+
+static uint32_t pool[ZPOOL_SIZE];
+static uint32_t npool = 0;
+
+uint32_t zpool_hits = 0;
+uint32_t zpool_misses = 0;
+
+
+static inline uint32_t irq_save() {
+    uint32_t eflags;
+    asm volatile("pushf; pop %0; cli" : "=r"(eflags));
+    return eflags;
+}
+
+static inline void irq_restore(uint32_t eflags) {
+    asm volatile("push %0; popf" :: "r"(eflags) : "memory", "cc");
+}
+
+// a zeroed frame, cleared inline when the pool is empty. FRAME_NONE when out of memory
+uint32_t zpool_alloc() {
+    uint32_t eflags = irq_save();
+    uint32_t frame;
+
+    if (npool > 0) {
+        frame = pool[--npool];
+        zpool_hits++;
+    } else {
+        frame = buddy_alloc(0);
+        if (frame != FRAME_NONE) {
+            zero_frame(frame);
+        }
+        zpool_misses++;
+    }
+
+    irq_restore(eflags);
+    return frame;
+}
+
+// gives a pooled frame back to a caller that ran the buddy allocator dry
+uint32_t zpool_pop() {
+    uint32_t eflags = irq_save();
+    uint32_t frame = (npool > 0) ? pool[--npool] : FRAME_NONE;
+    irq_restore(eflags);
+
+    return frame;
+}
+
+void zpool_refill() {
+    for (int i = 0; i < ZPOOL_BATCH; i++) {
+        uint32_t eflags = irq_save();
+
+        if (npool >= ZPOOL_SIZE || free_frames <= ZPOOL_RESERVE) {
+            irq_restore(eflags);
+            return;
+        }
+
+        uint32_t frame = buddy_alloc(0);
+        zero_frame(frame);
+        pool[npool++] = frame;
+
+        irq_restore(eflags);
+    }
+}
+
+uint32_t zpool_count() {
+    return npool;
+}
+
+void zpool_dump() {
+    serial_printf("zpool: %d/%d frames, %d hits, %d misses\n", npool, ZPOOL_SIZE, zpool_hits, zpool_misses);
+}
\ No newline at end of file
@@ -46,6 +46,7 @@ typedef struct file {
 void puts(const char *s);
 void fprintf(file_t *f, const char *s, ...);
 void scanf(char *dst, uint32_t size);
+int pread(file_t *fp, void *dst, uint32_t size, uint32_t offset);
 
 void sprintf(char *dst, const char *s, ...);
 
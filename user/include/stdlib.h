@@ -6,5 +6,6 @@
 
 void *malloc(uint32_t size);
 void free(void *ptr);
+void *realloc(void *ptr, uint32_t size);
 
 void exit(uint32_t ret);
\ No newline at end of file
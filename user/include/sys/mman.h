@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
+// read only file mappings, offset has to be page aligned
+void *mmap(char *path, uint32_t offset, uint32_t size);
+int munmap(void *addr);
\ No newline at end of file
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/task.h>
+
+#define SHM_SELF ((pid_t) -1)
+#define SHM_BASE 0x80000000 // every segment lives above, lower return values are errors
+
+// segments are identified by their address, which is the same in every task that maps them
+void *shm_create(uint32_t size);
+void *shm_map(void *shm, pid_t pid);
+int shm_unmap(void *shm);
+int shm_destroy(void *shm);
\ No newline at end of file
@@ -14,6 +14,19 @@
 #define SYS_GETVBEINFO  0x0B
 #define SYS_RQBUF       0x0C // request buffer
 #define SYS_BUFREADY    0x0D
+#define SYS_REGION      0x0E // allocate a page aligned region from the task heap
+#define SYS_FREEREGION  0x0F
+#define SYS_SHMCREATE   0x10 // create a shared memory segment
+#define SYS_SHMMAP      0x11 // map a segment into a task
+#define SYS_SHMUNMAP    0x12
+#define SYS_SHMDESTROY  0x13
+#define SYS_MMAP        0x14 // map a file, read only
+#define SYS_MUNMAP      0x15
+#define SYS_RESIZEREGION 0x16 // grow or shrink a region, in place when possible
+#define SYS_MEMSTAT     0x17 // memory usage of a task
+#define SYS_NICE        0x18 // scheduling level of a task, 0 (default) to 7
+#define SYS_SETRT       0x19 // periodic real time class, period 0 to leave it
+#define SYS_RTWAIT      0x1A // wait for the next period
 
 
 #define _Syscall_write(fp, s) { \
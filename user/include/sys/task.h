@@ -11,5 +11,36 @@ typedef enum {
     TASK_TERMINATED
 } task_state_t;
 
+// sizes are in pages unless noted, same layout as the kernel's task_mem_t
+typedef struct {
+    uint32_t resident;
+    uint32_t shared;
+    uint32_t swapped;
+    uint32_t heap_used; // bytes
+    uint32_t heap_free; // bytes
+    uint32_t page_tables;
+    uint32_t faults;
+    uint32_t major_faults;
+} task_mem_t;
+
 pid_t create_task(struct process_address_space *addr);
-int wait(pid_t pid);
\ No newline at end of file
+int wait(pid_t pid);
+
+// pid = -1 for the calling task
+int memstat(pid_t pid, task_mem_t *st);
+
+/*
+    higher values make a task yield to the others. only the calling task (pid = -1) and the tasks
+    it created can be changed. returns 0 or an errno value
+*/
+int nice(pid_t pid, int value);
+
+/*
+    runs a task at most budget ticks every period, finishing before deadline ticks into the period
+    (0 for the whole period). returns 0, or nonzero when the parameters are invalid or the cpu
+    is already reserved. like nice(), only the calling task (pid = -1) and its children can be changed
+*/
+int rt_set(pid_t pid, uint32_t period, uint32_t budget, uint32_t deadline);
+
+// gives up the rest of the period
+void rt_wait();
\ No newline at end of file
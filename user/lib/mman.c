@@ -0,0 +1,29 @@
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+void *mmap(char *path, uint32_t offset, uint32_t size) {
+    uint32_t addr;
+
+    asm volatile(
+        "int $0x7F"
+        : "=a"(addr)
+        : "a"(SYS_MMAP), "b"((uint32_t) path), "c"(offset), "d"(size)
+        : "memory"
+    );
+
+    return (addr == (uint32_t) -1) ? NULL : (void *) addr;
+}
+
+int munmap(void *addr) {
+    int ret;
+
+    asm volatile(
+        "int $0x7F"
+        : "=a"(ret)
+        : "a"(SYS_MUNMAP), "b"((uint32_t) addr)
+        : "memory"
+    );
+
+    return ret;
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include <stdlib.h>
+#include <sys/shm.h>
+#include <sys/syscall.h>
+
+void *shm_create(uint32_t size) {
+    uint32_t addr;
+
+    asm volatile(
+        "int $0x7F"
+        : "=a"(addr)
+        : "a"(SYS_SHMCREATE), "b"(size)
+        : "memory"
+    );
+
+    return (addr == (uint32_t) -1) ? NULL : (void *) addr;
+}
+
+// maps the segment into the task pid, SHM_SELF maps it into the calling task. pid has to be a child of the caller
+void *shm_map(void *shm, pid_t pid) {
+    uint32_t addr;
+
+    asm volatile(
+        "int $0x7F"
+        : "=a"(addr)
+        : "a"(SYS_SHMMAP), "b"((uint32_t) shm), "c"(pid)
+        : "memory"
+    );
+
+    return (addr == (uint32_t) -1 || addr < SHM_BASE) ? NULL : (void *) addr;
+}
+
+int shm_unmap(void *shm) {
+    int ret;
+
+    asm volatile(
+        "int $0x7F"
+        : "=a"(ret)
+        : "a"(SYS_SHMUNMAP), "b"((uint32_t) shm)
+        : "memory"
+    );
+
+    return ret;
+}
+
+int shm_destroy(void *shm) {
+    int ret;
+
+    asm volatile(
+        "int $0x7F"
+        : "=a"(ret)
+        : "a"(SYS_SHMDESTROY), "b"((uint32_t) shm)
+        : "memory"
+    );
+
+    return ret;
+}
\ No newline at end of file
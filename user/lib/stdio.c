@@ -130,12 +130,26 @@ void fprintf(file_t *f, const char *restrict s, ...) {
 void scanf(char *dst, uint32_t size) {
     asm volatile(
         "int $0x7F" // execution will pause here
-        :: "a"(SYS_READ), "b"((uint32_t) stdin), "c"(size), "d"((uint32_t) dst)
+        :: "a"(SYS_READ), "b"((uint32_t) stdin), "c"(size), "d"((uint32_t) dst), "S"(0)
     );
 
     return;
 }
 
+// reads a device from offset, returns the bytes read and 0 once offset is past the end
+int pread(file_t *fp, void *dst, uint32_t size, uint32_t offset) {
+    int ret = 0;
+
+    asm volatile(
+        "int $0x7F"
+        : "=a"(ret)
+        : "a"(SYS_READ), "b"((uint32_t) fp), "c"(size), "d"((uint32_t) dst), "S"(offset)
+        : "memory"
+    );
+
+    return ret;
+}
+
 void puts(const char *s) {
     if (s == (void *) 0) return;
 
@@ -1,30 +1,209 @@
 #include <stdlib.h>
+#include <string.h>
 #include <sys/syscall.h>
 
-__attribute__((malloc))
-void *malloc(uint32_t size) {
+/*
+    small blocks are served from per size class free lists, carved out of large chunks
+    requested with SYS_REGION. only chunk refills and large blocks trap into the kernel
+*/
+#define ARENA_CHUNK_SZ  0x10000 // 64 kb
+#define ARENA_MIN_SHIFT 4 // 16 b
+#define ARENA_NCLASSES  8 // 16 b -> 2 kb
+#define ARENA_MAX_SMALL (1 << (ARENA_MIN_SHIFT + ARENA_NCLASSES - 1))
+#define ARENA_LARGE     0xFF
+
+typedef struct {
+    uint32_t cls; // size class, ARENA_LARGE if the block owns its region
+    uint32_t size; // usable size
+} arena_hdr_t;
+
+typedef struct free_obj {
+    struct free_obj *next;
+} free_obj_t;
+
+static free_obj_t *bins[ARENA_NCLASSES];
+static uint8_t *chunk_ptr;
+static uint8_t *chunk_end;
+
+static void *region(uint32_t size) {
     uint32_t addr = 0;
 
     asm volatile(
         "int $0x7F\n"
         : "=a"(addr)
-        : "a"(SYS_MALLOC), "b"(size)
+        : "a"(SYS_REGION), "b"(size)
         : "memory"
     );
 
+    if (addr == (uint32_t) -1) {
+        return NULL;
+    }
     return (void *) addr;
 }
 
-void free(void *ptr) {
-    if (!ptr) return;
-
+static void free_region(void *ptr) {
     asm volatile(
         "int $0x7F"
-        :: "a"(SYS_FREE), "b"((uint32_t) ptr)
+        :: "a"(SYS_FREEREGION), "b"((uint32_t) ptr)
+        : "memory"
+    );
+}
+
+static void *resize_region(void *ptr, uint32_t size) {
+    uint32_t addr = 0;
+
+    asm volatile(
+        "int $0x7F\n"
+        : "=a"(addr)
+        : "a"(SYS_RESIZEREGION), "b"((uint32_t) ptr), "c"(size)
         : "memory"
     );
 
-    return;
+    if (addr == (uint32_t) -1) {
+        return NULL;
+    }
+    return (void *) addr;
+}
+
+// smallest class that fits the block and its header
+static inline uint32_t size_class(uint32_t size) {
+    uint32_t need = size + sizeof(arena_hdr_t);
+    if (need <= (1 << ARENA_MIN_SHIFT)) {
+        return 0;
+    }
+
+    return 32 - __builtin_clz(need - 1) - ARENA_MIN_SHIFT;
+}
+
+static void push_free(uint32_t cls, void *ptr) {
+    free_obj_t *obj = (free_obj_t *) ptr;
+    obj->next = bins[cls];
+    bins[cls] = obj;
+}
+
+static int refill_chunk() {
+    // hand the tail of the old chunk to the smaller classes
+    for (int cls = ARENA_NCLASSES - 1; cls >= 0 && chunk_ptr != NULL; cls--) {
+        uint32_t slot = 1 << (ARENA_MIN_SHIFT + cls);
+
+        while (chunk_ptr + slot <= chunk_end) {
+            push_free(cls, chunk_ptr);
+            chunk_ptr += slot;
+        }
+    }
+
+    chunk_ptr = (uint8_t *) region(ARENA_CHUNK_SZ);
+    if (chunk_ptr == NULL) {
+        chunk_end = NULL;
+        return -1;
+    }
+
+    chunk_end = chunk_ptr + ARENA_CHUNK_SZ;
+    return 0;
+}
+
+__attribute__((malloc))
+void *malloc(uint32_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+
+    arena_hdr_t *hdr;
+
+    if (size + sizeof(arena_hdr_t) > ARENA_MAX_SMALL) {
+        uint32_t len = size + sizeof(arena_hdr_t);
+        len = (len + 0xFFF) & ~0xFFF;
+
+        hdr = (arena_hdr_t *) region(len);
+        if (hdr == NULL) {
+            return NULL;
+        }
+
+        hdr->cls = ARENA_LARGE;
+        hdr->size = len - sizeof(arena_hdr_t);
+        return hdr + 1;
+    }
+
+    uint32_t cls = size_class(size);
+    uint32_t slot = 1 << (ARENA_MIN_SHIFT + cls);
+
+    if (bins[cls] != NULL) {
+        hdr = (arena_hdr_t *) bins[cls];
+        bins[cls] = bins[cls]->next;
+    } else {
+        if (chunk_ptr == NULL || chunk_ptr + slot > chunk_end) {
+            if (refill_chunk() != 0) {
+                return NULL;
+            }
+        }
+
+        hdr = (arena_hdr_t *) chunk_ptr;
+        chunk_ptr += slot;
+    }
+
+    hdr->cls = cls;
+    hdr->size = slot - sizeof(arena_hdr_t);
+    return hdr + 1;
+}
+
+void free(void *ptr) {
+    if (!ptr) return;
+
+    arena_hdr_t *hdr = (arena_hdr_t *) ptr - 1;
+
+    if (hdr->cls == ARENA_LARGE) {
+        free_region(hdr);
+        return;
+    }
+
+    push_free(hdr->cls, hdr);
+}
+
+/*
+    small blocks already have room up to their slot size. large blocks are resized by the kernel,
+    which grows the region in place when the heap allows it, so growing a buffer doesn't copy every time
+*/
+void *realloc(void *ptr, uint32_t size) {
+    if (ptr == NULL) {
+        return malloc(size);
+    }
+
+    if (size == 0) {
+        free(ptr);
+        return NULL;
+    }
+
+    arena_hdr_t *hdr = (arena_hdr_t *) ptr - 1;
+
+    if (hdr->cls == ARENA_LARGE && size + sizeof(arena_hdr_t) > ARENA_MAX_SMALL) {
+        uint32_t len = size + sizeof(arena_hdr_t);
+        len = (len + 0xFFF) & ~0xFFF;
+
+        if (len == hdr->size + sizeof(arena_hdr_t)) {
+            return ptr;
+        }
+
+        hdr = (arena_hdr_t *) resize_region(hdr, len);
+        if (hdr == NULL) {
+            return NULL;
+        }
+
+        hdr->size = len - sizeof(arena_hdr_t);
+        return hdr + 1;
+    }
+
+    if (hdr->cls != ARENA_LARGE && size <= hdr->size) {
+        return ptr;
+    }
+
+    void *n = malloc(size);
+    if (n == NULL) {
+        return NULL;
+    }
+
+    memcpy(n, ptr, (size < hdr->size) ? size : hdr->size);
+    free(ptr);
+    return n;
 }
 
 void exit(uint32_t ret) {
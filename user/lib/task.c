@@ -15,6 +15,53 @@ pid_t create_task(struct process_address_space *addr) {
     return pid;
 }
 
+int memstat(pid_t pid, task_mem_t *st) {
+    int ret;
+
+    asm volatile(
+        "int $0x7F"
+        : "=a"(ret)
+        : "a"(SYS_MEMSTAT), "b"(pid), "c"((uint32_t) st)
+        : "memory"
+    );
+
+    return ret;
+}
+
+int nice(pid_t pid, int value) {
+    int ret;
+
+    asm volatile(
+        "int $0x7F"
+        : "=a"(ret)
+        : "a"(SYS_NICE), "b"(pid), "c"(value)
+        : "memory"
+    );
+
+    return ret;
+}
+
+int rt_set(pid_t pid, uint32_t period, uint32_t budget, uint32_t deadline) {
+    int ret;
+
+    asm volatile(
+        "int $0x7F"
+        : "=a"(ret)
+        : "a"(SYS_SETRT), "b"(pid), "c"(period), "d"(budget), "S"(deadline)
+        : "memory"
+    );
+
+    return ret;
+}
+
+void rt_wait() {
+    asm volatile(
+        "int $0x7F"
+        :: "a"(SYS_RTWAIT)
+        : "memory"
+    );
+}
+
 int wait(pid_t pid) {
     int ret = -1;
     task_state_t state = TASK_READY;